@@ -0,0 +1,103 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef COBENCHMARK_BENCHMARK_H
+#define COBENCHMARK_BENCHMARK_H
+
+#include <lunchbox/log.h>
+#include <lunchbox/types.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/**
+ * Common helpers for the micro-benchmarks.
+ *
+ * Each benchmark prints one CSV line per measurement. All input data is
+ * generated from the seed given with '--seed <n>', so that results of
+ * different builds are comparable.
+ */
+namespace benchmark
+{
+/** The default seed used for all generated data. */
+static const uint64_t defaultSeed = 42;
+
+/** A reproducible xorshift64* random number generator. */
+class Random
+{
+public:
+    explicit Random( const uint64_t seed ) : _state( seed ? seed : 1 ) {}
+
+    uint64_t get()
+        {
+            _state ^= _state >> 12;
+            _state ^= _state << 25;
+            _state ^= _state >> 27;
+            return _state * 2685821657736338717ull;
+        }
+
+    /** @return a random number in [0, max). */
+    uint64_t get( const uint64_t max ) { return get() % max; }
+
+private:
+    uint64_t _state;
+};
+
+/** @return the value of '--seed <n>' or the default seed. */
+inline uint64_t getSeed( const int argc, char** argv )
+{
+    for( int i = 1; i < argc - 1; ++i )
+        if( ::strcmp( argv[i], "--seed" ) == 0 )
+            return ::strtoull( argv[i + 1], 0, 0 );
+    return defaultSeed;
+}
+
+/** Print the CSV header matching printResult(). */
+inline void printHeader()
+{
+    std::cout << "benchmark,case,operations,bytes,time_ms,ops_per_ms,"
+              << "MB_per_s,ratio" << std::endl;
+}
+
+/**
+ * Print the result of one measurement.
+ *
+ * @param benchmark the measured code path.
+ * @param name the name of the measured case.
+ * @param nOps the number of measured operations.
+ * @param nBytes the number of processed bytes, 0 if not applicable.
+ * @param time the time used for all operations, in milliseconds.
+ * @param ratio an optional output/input size ratio, 0 if not applicable.
+ */
+inline void printResult( const std::string& benchmark, const std::string& name,
+                         const uint64_t nOps, const uint64_t nBytes,
+                         float time, const float ratio = 0.f )
+{
+    if( time <= 0.f )
+        time = 1e-6f;
+
+    std::cout << benchmark << ',' << name << ',' << nOps << ',' << nBytes
+              << ',' << time << ',' << nOps / time << ','
+              << nBytes / 1024.f / 1024.f * 1000.f / time << ',';
+    if( ratio > 0.f )
+        std::cout << ratio;
+    std::cout << std::endl;
+}
+}
+
+#endif // COBENCHMARK_BENCHMARK_H
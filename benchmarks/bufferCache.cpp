@@ -0,0 +1,90 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Measures the BufferCache allocation and release rate.
+// Usage: ./benchmark_bufferCache [--seed <n>]
+
+#include "benchmark.h"
+
+#include <co/buffer.h>
+#include <co/bufferCache.h>
+#include <co/init.h>
+#include <lunchbox/clock.h>
+
+#include <vector>
+
+#define N_OPS 1000000
+#define BATCH_SIZE 64
+
+int main( int argc, char **argv )
+{
+    if( !co::init( argc, argv ))
+        return EXIT_FAILURE;
+
+    benchmark::Random rng( benchmark::getSeed( argc, argv ));
+    benchmark::printHeader();
+    {
+        co::BufferCache cache( 100 );
+        const uint64_t cacheSize = co::Buffer::getCacheSize();
+
+        // alloc and immediately release a small buffer, the receiver case
+        lunchbox::Clock clock;
+        for( size_t i = 0; i < N_OPS; ++i )
+        {
+            co::BufferPtr buffer = cache.alloc( cacheSize );
+            buffer->resize( cacheSize );
+        }
+        benchmark::printResult( "BufferCache", "alloc/free", N_OPS, 0,
+                                clock.getTimef( ));
+
+        // keep a batch of buffers alive, as queued commands do
+        std::vector< co::BufferPtr > buffers( BATCH_SIZE );
+        clock.reset();
+        for( size_t i = 0; i < N_OPS / BATCH_SIZE; ++i )
+        {
+            for( size_t j = 0; j < BATCH_SIZE; ++j )
+                buffers[j] = cache.alloc( cacheSize );
+            for( size_t j = 0; j < BATCH_SIZE; ++j )
+                buffers[j] = 0;
+        }
+        benchmark::printResult( "BufferCache", "batch alloc/free",
+                                N_OPS / BATCH_SIZE * BATCH_SIZE, 0,
+                                clock.getTimef( ));
+
+        // random sizes up to 64 KB, the buffers grow over time
+        std::vector< uint64_t > sizes( BATCH_SIZE * 16 );
+        for( size_t i = 0; i < sizes.size(); ++i )
+            sizes[i] = cacheSize + rng.get( LB_64KB );
+
+        uint64_t nBytes = 0;
+        clock.reset();
+        for( size_t i = 0; i < N_OPS / BATCH_SIZE; ++i )
+        {
+            for( size_t j = 0; j < BATCH_SIZE; ++j )
+            {
+                const uint64_t size = sizes[ ( i + j * 17 ) % sizes.size() ];
+                buffers[j] = cache.alloc( size );
+                nBytes += size;
+            }
+            for( size_t j = 0; j < BATCH_SIZE; ++j )
+                buffers[j] = 0;
+        }
+        benchmark::printResult( "BufferCache", "mixed size alloc/free",
+                                N_OPS / BATCH_SIZE * BATCH_SIZE, nBytes,
+                                clock.getTimef( ));
+    }
+    return co::exit() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
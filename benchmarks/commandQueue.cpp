@@ -0,0 +1,93 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Measures the single-threaded CommandQueue push and pop rate. See
+// tests/commandqueueperf.cpp for the handoff between threads.
+// Usage: ./benchmark_commandQueue [--seed <n>]
+
+#include "benchmark.h"
+
+#include <co/buffer.h>
+#include <co/bufferCache.h>
+#include <co/commandQueue.h>
+#include <co/iCommand.h>
+#include <co/init.h>
+#include <co/oCommand.h>
+#include <lunchbox/clock.h>
+
+#define N_COMMANDS 1000000
+#define BATCH_SIZE 256
+
+int main( int argc, char **argv )
+{
+    if( !co::init( argc, argv ))
+        return EXIT_FAILURE;
+
+    benchmark::printHeader();
+    {
+        co::BufferCache cache( 1 );
+        const uint64_t size = co::OCommand::getSize();
+        co::BufferPtr buffer = cache.alloc( co::Buffer::getCacheSize( ));
+        buffer->resize( size );
+        reinterpret_cast< uint64_t* >( buffer->getData( ))[ 0 ] = size;
+
+        co::ICommand command( 0, 0, buffer, false /*swap*/ );
+        command.setCommand( 0 );
+        command.setType( co::COMMANDTYPE_CUSTOM );
+
+        co::CommandQueue queue;
+        lunchbox::Clock clock;
+        for( size_t i = 0; i < N_COMMANDS; ++i )
+        {
+            queue.push( command );
+            queue.pop();
+        }
+        benchmark::printResult( "CommandQueue", "push/pop", N_COMMANDS, 0,
+                                clock.getTimef( ));
+
+        clock.reset();
+        for( size_t i = 0; i < N_COMMANDS / BATCH_SIZE; ++i )
+        {
+            for( size_t j = 0; j < BATCH_SIZE; ++j )
+                queue.push( command );
+            for( size_t j = 0; j < BATCH_SIZE; ++j )
+                queue.pop();
+        }
+        benchmark::printResult( "CommandQueue", "batch push/pop",
+                                N_COMMANDS / BATCH_SIZE * BATCH_SIZE, 0,
+                                clock.getTimef( ));
+
+        co::ICommands commands;
+        size_t nPopped = 0;
+        clock.reset();
+        for( size_t i = 0; i < N_COMMANDS / BATCH_SIZE; ++i )
+        {
+            for( size_t j = 0; j < BATCH_SIZE; ++j )
+                queue.push( command );
+            nPopped += queue.popAll( commands );
+            commands.clear();
+        }
+        benchmark::printResult( "CommandQueue", "batch push/popAll", nPopped,
+                                0, clock.getTimef( ));
+
+        clock.reset();
+        for( size_t i = 0; i < N_COMMANDS; ++i )
+            queue.tryPop();
+        benchmark::printResult( "CommandQueue", "tryPop empty", N_COMMANDS, 0,
+                                clock.getTimef( ));
+    }
+    return co::exit() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,181 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Measures compression and decompression speed and ratio of all registered
+// byte compressors on generated data sets.
+// Usage: ./benchmark_compressor [--seed <n>]
+
+#include "benchmark.h"
+
+#include <co/global.h>
+#include <co/init.h>
+#include <co/pluginRegistry.h>
+#include <lunchbox/buffer.h>
+#include <lunchbox/clock.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <co/compressorInfo.h> // private header
+#include <co/cpuCompressor.h> // private header
+#include <co/plugin.h> // private header
+
+#define N_ROUNDS 5
+#define CORPUS_SIZE ( 4u << 20 )
+
+namespace
+{
+struct Corpus
+{
+    std::string name;
+    std::vector< uint8_t > data;
+};
+typedef std::vector< Corpus > Corpora;
+
+std::vector< uint32_t > _getCompressorNames()
+{
+    const co::Plugins& plugins = co::Global::getPluginRegistry().getPlugins();
+    std::vector< uint32_t > names;
+
+    for( co::PluginsCIter i = plugins.begin(); i != plugins.end(); ++i )
+    {
+        const co::CompressorInfos& infos = (*i)->getInfos();
+        for( co::CompressorInfosCIter j = infos.begin(); j != infos.end(); ++j )
+            if( j->tokenType == EQ_COMPRESSOR_DATATYPE_BYTE )
+                names.push_back( j->name );
+    }
+
+    std::sort( names.begin(), names.end( ));
+    return names;
+}
+
+/** Generate data sets resembling typical object data. */
+Corpora _getCorpora( benchmark::Random& rng )
+{
+    Corpora corpora( 4 );
+    for( size_t i = 0; i < corpora.size(); ++i )
+        corpora[i].data.resize( CORPUS_SIZE );
+
+    corpora[0].name = "random";
+    uint8_t* data = &corpora[0].data.front();
+    for( size_t i = 0; i < CORPUS_SIZE; ++i )
+        data[i] = uint8_t( rng.get( ));
+
+    static const char* words[] = { "the", "object", "version", "commit",
+                                   "node", "of", "and", "sync", "data", "a",
+                                   "connection", "to", "in", "barrier" };
+    const size_t nWords = sizeof( words ) / sizeof( words[0] );
+    corpora[1].name = "text";
+    data = &corpora[1].data.front();
+    for( size_t i = 0; i < CORPUS_SIZE; )
+    {
+        const char* word = words[ rng.get( nWords ) ];
+        for( ; *word && i < CORPUS_SIZE; ++word, ++i )
+            data[i] = uint8_t( *word );
+        if( i < CORPUS_SIZE )
+            data[i++] = ' ';
+    }
+
+    corpora[2].name = "indices";
+    uint32_t* indices = reinterpret_cast< uint32_t* >(
+        &corpora[2].data.front( ));
+    for( size_t i = 0; i < CORPUS_SIZE / sizeof( uint32_t ); ++i )
+        indices[i] = uint32_t( i / 3 + rng.get( 16 ));
+
+    corpora[3].name = "sparse";
+    data = &corpora[3].data.front();
+    for( size_t i = 0; i < CORPUS_SIZE; ++i )
+        data[i] = rng.get( 16 ) == 0 ? uint8_t( rng.get( )) : 0;
+
+    return corpora;
+}
+
+void _run( const uint32_t name, const Corpus& corpus )
+{
+    co::CPUCompressor compressor;
+    co::CPUCompressor decompressor;
+    compressor.co::Compressor::initCompressor( name );
+    decompressor.co::Compressor::initDecompressor( name );
+
+    uint8_t* in = const_cast< uint8_t* >( &corpus.data.front( ));
+    const uint64_t size = corpus.data.size();
+    const uint64_t flags = EQ_COMPRESSOR_DATA_1D;
+    uint64_t inDims[2] = { 0, size };
+
+    lunchbox::Clock clock;
+    for( size_t i = 0; i < N_ROUNDS; ++i )
+        compressor.compress( in, inDims, flags );
+    const float compressTime = clock.getTimef();
+
+    const unsigned nResults = compressor.getNumResults();
+    std::vector< void* > results( nResults );
+    std::vector< uint64_t > sizes( nResults );
+    uint64_t compressedSize = 0;
+    for( unsigned i = 0; i < nResults; ++i )
+    {
+        compressor.getResult( i, &results[i], &sizes[i] );
+        compressedSize += sizes[i];
+    }
+
+    lunchbox::Bufferb out;
+    out.resize( size );
+    clock.reset();
+    for( size_t i = 0; i < N_ROUNDS; ++i )
+        decompressor.decompress( &results.front(), &sizes.front(), nResults,
+                                 out.getData(), inDims );
+    const float decompressTime = clock.getTimef();
+
+    if( ::memcmp( out.getData(), in, size ) != 0 )
+        LBERROR << "Decompressed data differs using compressor 0x"
+                << std::hex << name << std::dec << std::endl;
+
+    std::ostringstream caseName;
+    caseName << corpus.name << " 0x" << std::hex << std::setw( 8 )
+             << std::setfill( '0' ) << name;
+    const float ratio = float( compressedSize ) / float( size );
+    benchmark::printResult( "compress", caseName.str(), N_ROUNDS,
+                            N_ROUNDS * size, compressTime, ratio );
+    benchmark::printResult( "decompress", caseName.str(), N_ROUNDS,
+                            N_ROUNDS * size, decompressTime, ratio );
+}
+}
+
+int main( int argc, char **argv )
+{
+    co::Global::getPluginRegistry().addDirectory( std::string( CO_BUILD_DIR ) +
+                                                  "/lib" );
+    if( !co::init( argc, argv ))
+        return EXIT_FAILURE;
+
+    benchmark::Random rng( benchmark::getSeed( argc, argv ));
+    benchmark::printHeader();
+
+    const Corpora corpora = _getCorpora( rng );
+    const std::vector< uint32_t > names = _getCompressorNames();
+    for( std::vector< uint32_t >::const_iterator i = names.begin();
+         i != names.end(); ++i )
+    {
+        for( Corpora::const_iterator j = corpora.begin(); j != corpora.end();
+             ++j )
+        {
+            _run( *i, *j );
+        }
+    }
+
+    return co::exit() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,203 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Measures DataOStream and DataIStream throughput for scalars, strings, vectors
+// and maps. The streams work on memory, no data is sent.
+// Usage: ./benchmark_dataStream [--seed <n>]
+
+#include "benchmark.h"
+
+#include <co/connection.h>
+#include <co/connectionDescription.h>
+#include <co/dataIStream.h>
+#include <co/dataOStream.h>
+#include <co/init.h>
+#include <co/plugins/compressorTypes.h>
+#include <lunchbox/clock.h>
+
+#include <map>
+#include <vector>
+
+#define N_ROUNDS 10
+
+namespace
+{
+typedef std::vector< uint8_t > Chunk;
+typedef std::vector< Chunk > Chunks;
+
+/** Counts or captures the flushed data. */
+class OStream : public co::DataOStream
+{
+public:
+    OStream( co::ConnectionPtr connection ) : nBytes( 0 ), capture( false )
+        { _setupConnection( connection ); }
+
+    void enable() { _enable(); }
+
+    uint64_t nBytes;
+    bool capture;
+    Chunks chunks;
+
+protected:
+    virtual void sendData( const void* buffer, const uint64_t size,
+                           const bool )
+        {
+            nBytes += size;
+            if( !capture || size == 0 )
+                return;
+
+            const uint8_t* data = static_cast< const uint8_t* >( buffer );
+            chunks.push_back( Chunk( data, data + size ));
+        }
+};
+
+/** Reads the data captured by an OStream. */
+class IStream : public co::DataIStream
+{
+public:
+    IStream( const Chunks& chunks )
+        : co::DataIStream( false /*swap*/ ), _chunks( chunks ), _next( 0 ) {}
+
+    void rewind() { reset(); _next = 0; }
+
+    virtual size_t nRemainingBuffers() const { return _chunks.size() - _next; }
+    virtual co::uint128_t getVersion() const { return co::VERSION_NONE; }
+    virtual co::NodePtr getMaster() { return 0; }
+
+protected:
+    virtual bool getNextBuffer( uint32_t& compressor, uint32_t& nChunks,
+                                const void** chunkData, uint64_t& size )
+        {
+            if( _next >= _chunks.size( ))
+                return false;
+
+            const Chunk& chunk = _chunks[ _next++ ];
+            compressor = EQ_COMPRESSOR_NONE;
+            nChunks = 1;
+            *chunkData = &chunk.front();
+            size = chunk.size();
+            return true;
+        }
+
+private:
+    const Chunks& _chunks;
+    size_t _next;
+};
+
+template< class T >
+void _run( const std::string& name, const std::vector< T >& values,
+           co::ConnectionPtr connection )
+{
+    OStream os( connection );
+    lunchbox::Clock clock;
+    for( size_t i = 0; i < N_ROUNDS; ++i )
+    {
+        os.enable();
+        for( size_t j = 0; j < values.size(); ++j )
+            os << values[j];
+        os.disable();
+    }
+    const uint64_t nBytes = os.nBytes;
+    benchmark::printResult( "DataOStream", name, N_ROUNDS * values.size(),
+                            nBytes, clock.getTimef( ));
+
+    os.capture = true;
+    os.enable();
+    for( size_t j = 0; j < values.size(); ++j )
+        os << values[j];
+    os.disable();
+
+    IStream is( os.chunks );
+    T value;
+    clock.reset();
+    for( size_t i = 0; i < N_ROUNDS; ++i )
+    {
+        is.rewind();
+        for( size_t j = 0; j < values.size(); ++j )
+            is >> value;
+    }
+    benchmark::printResult( "DataIStream", name, N_ROUNDS * values.size(),
+                            nBytes, clock.getTimef( ));
+
+    if( !( value == values.back( )))
+        LBERROR << "Read wrong data for " << name << std::endl;
+}
+
+std::string _getString( benchmark::Random& rng )
+{
+    std::string string( 8 + rng.get( 57 ), ' ' );
+    for( size_t i = 0; i < string.size(); ++i )
+        string[i] = 'a' + char( rng.get( 26 ));
+    return string;
+}
+}
+
+int main( int argc, char **argv )
+{
+    if( !co::init( argc, argv ))
+        return EXIT_FAILURE;
+
+    benchmark::Random rng( benchmark::getSeed( argc, argv ));
+    benchmark::printHeader();
+
+    co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
+    desc->type = co::CONNECTIONTYPE_PIPE;
+    co::ConnectionPtr connection = co::Connection::create( desc );
+    if( !connection->connect( ))
+    {
+        LBERROR << "Can't create pipe connection" << std::endl;
+        co::exit();
+        return EXIT_FAILURE;
+    }
+
+    std::vector< uint32_t > scalars( 262144 );
+    for( size_t i = 0; i < scalars.size(); ++i )
+        scalars[i] = uint32_t( rng.get( ));
+    _run( "uint32_t", scalars, connection );
+
+    std::vector< double > doubles( 262144 );
+    for( size_t i = 0; i < doubles.size(); ++i )
+        doubles[i] = double( rng.get( )) / 3.;
+    _run( "double", doubles, connection );
+
+    std::vector< std::string > strings( 16384 );
+    for( size_t i = 0; i < strings.size(); ++i )
+        strings[i] = _getString( rng );
+    _run( "string", strings, connection );
+
+    std::vector< std::vector< double > > vectors( 64 );
+    for( size_t i = 0; i < vectors.size(); ++i )
+        vectors[i].assign( doubles.begin() + i * 4096,
+                           doubles.begin() + ( i + 1 ) * 4096 );
+    _run( "vector<double>", vectors, connection );
+
+    std::vector< std::vector< std::string > > stringVectors( 64 );
+    for( size_t i = 0; i < stringVectors.size(); ++i )
+        stringVectors[i].assign( strings.begin() + i * 256,
+                                 strings.begin() + ( i + 1 ) * 256 );
+    _run( "vector<string>", stringVectors, connection );
+
+    typedef std::map< uint32_t, uint64_t > Map;
+    std::vector< Map > maps( 64 );
+    for( size_t i = 0; i < maps.size(); ++i )
+        for( size_t j = 0; j < 256; ++j )
+            maps[i][ uint32_t( rng.get( )) ] = rng.get();
+    _run( "map<uint32_t,uint64_t>", maps, connection );
+
+    connection->close();
+    connection = 0;
+    return co::exit() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,91 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Measures the cost of copying ICommands, as done by the dispatcher for each
+// queued command.
+// Usage: ./benchmark_iCommand [--seed <n>]
+
+#include "benchmark.h"
+
+#include <co/buffer.h>
+#include <co/bufferCache.h>
+#include <co/iCommand.h>
+#include <co/init.h>
+#include <co/oCommand.h>
+#include <lunchbox/clock.h>
+
+#include <cstring>
+
+#include <co/nodeCommand.h> // private header
+
+#define N_COPIES 1000000
+
+int main( int argc, char **argv )
+{
+    if( !co::init( argc, argv ))
+        return EXIT_FAILURE;
+
+    benchmark::printHeader();
+    {
+        co::BufferCache cache( 1 );
+        const uint64_t size = co::OCommand::getSize();
+        co::BufferPtr buffer = cache.alloc( co::Buffer::getCacheSize( ));
+        buffer->resize( size );
+
+        // untraced node command header: size, type, command
+        const uint32_t type = co::COMMANDTYPE_NODE;
+        const uint32_t cmd = co::CMD_NODE_COMMAND;
+        uint8_t* data = buffer->getData();
+        ::memcpy( data, &size, sizeof( size ));
+        ::memcpy( data + sizeof( size ), &type, sizeof( type ));
+        ::memcpy( data + sizeof( size ) + sizeof( type ), &cmd, sizeof( cmd ));
+
+        const co::ICommand command( 0, 0, buffer, false /*swap*/ );
+        size_t nValid = 0;
+
+        lunchbox::Clock clock;
+        for( size_t i = 0; i < N_COPIES; ++i )
+        {
+            const co::ICommand copy( command );
+            nValid += copy.isValid();
+        }
+        benchmark::printResult( "ICommand", "copy construct", N_COPIES, 0,
+                                clock.getTimef( ));
+
+        co::ICommand copy;
+        clock.reset();
+        for( size_t i = 0; i < N_COPIES; ++i )
+        {
+            copy = command;
+            nValid += copy.isValid();
+        }
+        benchmark::printResult( "ICommand", "assign", N_COPIES, 0,
+                                clock.getTimef( ));
+
+        clock.reset();
+        for( size_t i = 0; i < N_COPIES; ++i )
+        {
+            const co::ICommand created( 0, 0, buffer, false /*swap*/ );
+            nValid += created.isValid();
+        }
+        benchmark::printResult( "ICommand", "construct from buffer", N_COPIES,
+                                0, clock.getTimef( ));
+
+        if( nValid != 3 * N_COPIES )
+            LBERROR << "Invalid command copies" << std::endl;
+    }
+    return co::exit() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -21,6 +21,7 @@
 
 #include "iCommand.h"
 #include "connection.h"
+#include "connections.h"
 #include "dataIStream.h"
 #include "dataOStream.h"
 #include "global.h"
@@ -30,7 +31,9 @@
 #include "barrierCommand.h"
 #include "exception.h"
 
+#include <lunchbox/lock.h>
 #include <lunchbox/monitor.h>
+#include <lunchbox/scopedMutex.h>
 #include <lunchbox/stdExt.h>
 
 namespace co
@@ -49,6 +52,16 @@ struct Request
 
 typedef stde::hash_map< uint128_t, Request > RequestMap;
 typedef RequestMap::iterator RequestMapIter;
+typedef std::vector< NodeID > NodeIDs;
+typedef NodeIDs::const_iterator NodeIDsCIter;
+
+/** @return the number of nodes released through each subtree head. */
+size_t _getSubtreeSize( const size_t nNodes, const uint32_t fanout )
+{
+    if( fanout == 0 || nNodes <= fanout )
+        return 1;
+    return ( nNodes + fanout - 1 ) / fanout;
+}
 }
 
 namespace detail
@@ -77,6 +90,15 @@ public:
 
     /** The monitor used for barrier leave notification. */
     lunchbox::Monitor< uint32_t > leaveNotify;
+
+    /**
+     * The subtree heads this slave forwarded the last release to, connected
+     * from the application thread on the next enter.
+     */
+    NodeIDs children;
+
+    /** Protects the master state and the children against app threads. */
+    lunchbox::Lock lock;
 };
 }
 
@@ -140,12 +162,14 @@ void Barrier::attach( const UUID& id, const uint32_t instanceID )
     Object::attach( id, instanceID );
 
     LocalNodePtr node = getLocalNode();
-    CommandQueue* queue = node->getCommandThreadQueue();
+    CommandQueue* queue = node->getCommandThreadQueue( id );
 
     registerCommand( CMD_BARRIER_ENTER,
                      CmdFunc( this, &Barrier::_cmdEnter ), queue );
     registerCommand( CMD_BARRIER_ENTER_REPLY,
                      CmdFunc( this, &Barrier::_cmdEnterReply ), queue );
+    registerCommand( CMD_BARRIER_RELEASE,
+                     CmdFunc( this, &Barrier::_cmdRelease ), queue );
 
     if( _impl->masterID == NodeID::ZERO )
         _impl->masterID = node->getNodeID();
@@ -159,12 +183,23 @@ void Barrier::enter( const uint32_t timeout )
     if( _impl->height == 1 ) // trivial ;)
         return;
 
-    if( !_impl->master )
+    LocalNodePtr localNode = getLocalNode();
+    if( _impl->masterID == localNode->getNodeID( ))
     {
-        LocalNodePtr localNode = getLocalNode();
-        _impl->master = localNode->connect( _impl->masterID );
+        // OPT: enter directly, without a command to ourself
+        LBLOG( LOG_BARRIER ) << "enter local barrier " << getID() << " v"
+                             << getVersion() << ", height " << _impl->height
+                             << std::endl;
+
+        const uint32_t incarnation = _impl->leaveNotify.get();
+        _enter( getVersion(), incarnation, timeout, localNode );
+        _waitLeave( incarnation + 1, timeout );
+        return;
     }
 
+    if( !_impl->master )
+        _impl->master = localNode->connect( _impl->masterID );
+
     LBASSERT( _impl->master );
     LBASSERT( _impl->master->isReachable( ));
     if( !_impl->master || !_impl->master->isReachable( ))
@@ -174,6 +209,8 @@ void Barrier::enter( const uint32_t timeout )
         return;
     }
 
+    _connectChildren();
+
     LBLOG( LOG_BARRIER ) << "enter barrier " << getID() << " v" << getVersion()
                          << ", height " << _impl->height << std::endl;
 
@@ -181,7 +218,34 @@ void Barrier::enter( const uint32_t timeout )
 
     send( _impl->master, CMD_BARRIER_ENTER )
         << getVersion() << _impl->leaveNotify.get() << timeout;
+    _waitLeave( leaveVal, timeout );
+}
+
+void Barrier::_connectChildren()
+{
+    NodeIDs children;
+    {
+        lunchbox::ScopedMutex<> mutex( _impl->lock );
+        children.swap( _impl->children );
+    }
+
+    // The release tree is stable between rounds, connecting here lets the
+    // command thread forward the next release without blocking.
+    LocalNodePtr localNode = getLocalNode();
+    for( NodeIDsCIter i = children.begin(); i != children.end(); ++i )
+    {
+        NodePtr node = localNode->getNode( *i );
+        if( node && node->isConnected( ))
+            continue;
 
+        node = localNode->connect( *i );
+        if( !node || !node->isConnected( ))
+            LBWARN << "Can't connect barrier node " << *i << std::endl;
+    }
+}
+
+void Barrier::_waitLeave( const uint32_t leaveVal, const uint32_t timeout )
+{
     if( timeout == LB_TIMEOUT_INDEFINITE )
         _impl->leaveNotify.waitEQ( leaveVal );
     else if( !_impl->leaveNotify.timedWaitEQ( leaveVal, timeout ))
@@ -206,6 +270,14 @@ bool Barrier::_cmdEnter( ICommand& cmd )
                          << " v" << version
                          << " barrier v" << getVersion() << std::endl;
 
+    _enter( version, incarnation, timeout, command.getNode( ));
+    return true;
+}
+
+void Barrier::_enter( const uint128_t& version, const uint32_t incarnation,
+                      const uint32_t timeout, NodePtr node )
+{
+    lunchbox::ScopedMutex<> mutex( _impl->lock );
     Request& request = _impl->enteredNodes[ version ];
 
     LBLOG( LOG_BARRIER ) << "enter barrier v" << version
@@ -226,8 +298,8 @@ bool Barrier::_cmdEnter( ICommand& cmd )
         if( request.incarnation < incarnation )
         {
             // send directly the reply command to unblock the caller
-            _sendNotify( version, command.getNode( ));
-            return true;
+            _sendNotify( version, node );
+            return;
         }
         // the previous enter had a timeout, start a newsynchronization
         else if( request.incarnation != incarnation )
@@ -237,7 +309,7 @@ bool Barrier::_cmdEnter( ICommand& cmd )
             request.timeout = timeout;
         }
     }
-    request.nodes.push_back( command.getNode( ));
+    request.nodes.push_back( node );
 
     // clean older data which was not removed during older synchronization
     if( request.timeout != LB_TIMEOUT_INDEFINITE )
@@ -250,41 +322,37 @@ bool Barrier::_cmdEnter( ICommand& cmd )
     // the later version, in which case deadlocks might happen because the later
     // version never leaves the barrier. We simply assume this is not the case.
     if( version > getVersion( ))
-        return true;
+        return;
 
     // if it's an older version a timeout has been handled
     // for performance, send directly the order to unblock the caller.
     if( timeout != LB_TIMEOUT_INDEFINITE && version < getVersion( ))
     {
         LBASSERT( incarnation == 0 );
-        _sendNotify( version, command.getNode( ) );
-        return true;
+        _sendNotify( version, node );
+        return;
     }
 
     LBASSERT( version == getVersion( ));
 
     Nodes& nodes = request.nodes;
     if( nodes.size() < _impl->height )
-        return true;
+        return;
 
     LBASSERT( nodes.size() == _impl->height );
     LBLOG( LOG_BARRIER ) << "Barrier reached" << std::endl;
 
     stde::usort( nodes );
-
-    for( NodesIter i = nodes.begin(); i != nodes.end(); ++i )
-        _sendNotify( version, *i );
+    _release( version, nodes );
 
     // delete node vector for version
     RequestMapIter i = _impl->enteredNodes.find( version );
     LBASSERT( i != _impl->enteredNodes.end( ));
     _impl->enteredNodes.erase( i );
-    return true;
 }
 
 void Barrier::_sendNotify( const uint128_t& version, NodePtr node )
 {
-    LB_TS_THREAD( _thread );
     LBASSERTINFO( !_impl->master || _impl->master == getLocalNode(),
                   _impl->master );
 
@@ -299,13 +367,77 @@ void Barrier::_sendNotify( const uint128_t& version, NodePtr node )
     else
     {
         LBLOG( LOG_BARRIER ) << "Unlock " << node << std::endl;
-        send( node, CMD_BARRIER_ENTER_REPLY ) << version;
+        send( node, CMD_BARRIER_ENTER_REPLY ) << version << 0u << NodeIDs();
+    }
+}
+
+void Barrier::_release( const uint128_t& version, const Nodes& nodes )
+{
+    Nodes remoteNodes;
+    remoteNodes.reserve( nodes.size( ));
+    for( NodesCIter i = nodes.begin(); i != nodes.end(); ++i )
+    {
+        NodePtr node = *i;
+        if( node->isLocal( ))
+            _sendNotify( version, node );
+        else
+            remoteNodes.push_back( node );
+    }
+
+    if( remoteNodes.empty( ))
+        return;
+
+    if( Global::getIAttribute( Global::IATTR_BARRIER_MULTICAST ) &&
+        remoteNodes.size() > 1 )
+    {
+        // one send per multicast group, unicast to all others
+        Connections connections;
+        gatherConnections( remoteNodes, connections );
+        ObjectOCommand( connections, CMD_BARRIER_ENTER_REPLY,
+                        COMMANDTYPE_OBJECT, getID(), EQ_INSTANCE_NONE )
+            << version << 0u << NodeIDs();
+        return;
+    }
+
+    const int32_t fanout =
+        Global::getIAttribute( Global::IATTR_BARRIER_FANOUT );
+    _forward( version, remoteNodes, fanout > 0 ? uint32_t( fanout ) : 0 );
+}
+
+void Barrier::_forward( const uint128_t& version, const Nodes& nodes,
+                        const uint32_t fanout )
+{
+    const size_t nNodes = nodes.size();
+    const size_t subtreeSize = _getSubtreeSize( nNodes, fanout );
+    if( subtreeSize == 1 )
+    {
+        for( NodesCIter i = nodes.begin(); i != nodes.end(); ++i )
+        {
+            LBLOG( LOG_BARRIER ) << "Unlock " << *i << std::endl;
+            send( *i, CMD_BARRIER_ENTER_REPLY ) << version << 0u << NodeIDs();
+        }
+        return;
+    }
+
+    // Split the nodes into fanout subtrees, the first node of each subtree
+    // forwards the release to the remaining nodes of its subtree.
+    for( size_t i = 0; i < nNodes; i += subtreeSize )
+    {
+        const size_t end = LB_MIN( i + subtreeSize, nNodes );
+        NodeIDs subtree;
+        subtree.reserve( end - i - 1 );
+        for( size_t j = i + 1; j < end; ++j )
+            subtree.push_back( nodes[ j ]->getNodeID( ));
+
+        LBLOG( LOG_BARRIER ) << "Unlock " << nodes[ i ] << " and "
+                             << subtree.size() << " nodes" << std::endl;
+        send( nodes[ i ], CMD_BARRIER_ENTER_REPLY )
+            << version << fanout << subtree;
     }
 }
 
 void Barrier::_cleanup( const uint64_t time )
 {
-    LB_TS_THREAD( _thread );
     LBASSERTINFO( !_impl->master || _impl->master == getLocalNode(),
                   _impl->master );
 
@@ -338,6 +470,45 @@ bool Barrier::_cmdEnterReply( ICommand& cmd )
     LB_TS_THREAD( _thread );
     LBLOG( LOG_BARRIER ) << "Got ok, unlock local user(s)" << std::endl;
     const uint128_t version = command.get< uint128_t >();
+    const uint32_t fanout = command.get< uint32_t >();
+    const NodeIDs subtree = command.get< NodeIDs >();
+
+    if( !subtree.empty( ))
+    {
+        // Remember the subtree heads to connect them on the next enter()
+        const size_t subtreeSize = _getSubtreeSize( subtree.size(), fanout );
+        NodeIDs children;
+        for( size_t i = 0; i < subtree.size(); i += subtreeSize )
+            children.push_back( subtree[ i ] );
+        {
+            lunchbox::ScopedMutex<> mutex( _impl->lock );
+            _impl->children.swap( children );
+        }
+
+        // Only forward to connected nodes, connecting here would block the
+        // command thread. The master releases all others.
+        LocalNodePtr localNode = getLocalNode();
+        Nodes nodes;
+        NodeIDs unconnected;
+        nodes.reserve( subtree.size( ));
+        for( NodeIDsCIter i = subtree.begin(); i != subtree.end(); ++i )
+        {
+            NodePtr node = localNode->getNode( *i );
+            if( node && node->isConnected( ))
+                nodes.push_back( node );
+            else
+                unconnected.push_back( *i );
+        }
+        _forward( version, nodes, fanout );
+
+        if( !unconnected.empty( ))
+        {
+            LBLOG( LOG_BARRIER ) << "Return " << unconnected.size()
+                                 << " unconnected nodes to master" << std::endl;
+            send( _impl->master, CMD_BARRIER_RELEASE )
+                << version << unconnected;
+        }
+    }
 
     if( version == getVersion( ))
         ++_impl->leaveNotify;
@@ -345,4 +516,24 @@ bool Barrier::_cmdEnterReply( ICommand& cmd )
     return true;
 }
 
+bool Barrier::_cmdRelease( ICommand& cmd )
+{
+    ObjectICommand command( cmd );
+    LB_TS_THREAD( _thread );
+    const uint128_t version = command.get< uint128_t >();
+    const NodeIDs nodeIDs = command.get< NodeIDs >();
+
+    LocalNodePtr localNode = getLocalNode();
+    for( NodeIDsCIter i = nodeIDs.begin(); i != nodeIDs.end(); ++i )
+    {
+        NodePtr node = localNode->getNode( *i );
+        if( node )
+            _sendNotify( version, node );
+        else
+            LBWARN << "Can't release unknown node " << *i << " from barrier"
+                   << std::endl;
+    }
+    return true;
+}
+
 }
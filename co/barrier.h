@@ -76,6 +76,13 @@ namespace detail { class Barrier; }
          * The implementation currently assumes that the master node instance
          * also enters the barrier. If a timeout happens a timeout exception is
          * thrown.
+         *
+         * The master releases all participants directly, unless
+         * Global::IATTR_BARRIER_MULTICAST or Global::IATTR_BARRIER_FANOUT are
+         * set on the master node. With multicast, one release is sent to each
+         * multicast group. With a fanout, the release is forwarded along a
+         * tree of the given degree, which requires that the participating
+         * nodes can connect to each other.
          * @version 1.0
          */
         CO_API void enter( const uint32_t timeout = LB_TIMEOUT_INDEFINITE );
@@ -97,12 +104,20 @@ namespace detail { class Barrier; }
     private:
         detail::Barrier* const _impl;
 
+        void _enter( const uint128_t& version, const uint32_t incarnation,
+                     const uint32_t timeout, NodePtr node );
+        void _waitLeave( const uint32_t leaveVal, const uint32_t timeout );
+        void _connectChildren();
         void _cleanup( const uint64_t time );
         void _sendNotify( const uint128_t& version, NodePtr node );
+        void _release( const uint128_t& version, const Nodes& nodes );
+        void _forward( const uint128_t& version, const Nodes& nodes,
+                       const uint32_t fanout );
 
         /* The command handlers. */
         bool _cmdEnter( ICommand& command );
         bool _cmdEnterReply( ICommand& command );
+        bool _cmdRelease( ICommand& command );
 
         LB_TS_VAR( _thread );
     };
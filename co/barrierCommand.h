@@ -25,7 +25,8 @@ namespace co
     enum BarrierCommand
     {
         CMD_BARRIER_ENTER = CMD_OBJECT_CUSTOM,
-        CMD_BARRIER_ENTER_REPLY
+        CMD_BARRIER_ENTER_REPLY,
+        CMD_BARRIER_RELEASE //!< nodes the forwarder is not connected to
     };
 }
 
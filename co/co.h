@@ -63,9 +63,11 @@
 
 #include <co/barrier.h>
 #include <co/buffer.h>
+#include <co/commandStats.h>
 #include <co/connection.h>
 #include <co/connectionDescription.h>
 #include <co/connectionSet.h>
+#include <co/connectionStats.h>
 #include <co/connectionType.h>
 #include <co/customICommand.h>
 #include <co/customOCommand.h>
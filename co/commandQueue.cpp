@@ -1,4 +1,3 @@
-
 /* Copyright (c) 2005-2012, Stefan Eilemann <eile@equalizergraphics.com>
  *
  * This library is free software; you can redistribute it and/or modify it under
@@ -17,21 +16,194 @@
 
 #include "commandQueue.h"
 
+#include "commandStats.h"
 #include "iCommand.h"
 #include "exception.h"
 #include "node.h"
 
-#include <lunchbox/mtQueue.h>
+#include <lunchbox/atomic.h>
+#include <lunchbox/compareAndSwap.h>
+#include <lunchbox/condition.h>
 
 namespace co
 {
+namespace
+{
+static const uint32_t _minSpins = 16;
+static const uint32_t _maxSpins = 4096;
+}
+
 namespace detail
 {
+/**
+ * Multi-producer, single-consumer queue.
+ *
+ * Producers push onto lock-free stacks. The consumer takes a whole stack at
+ * once and moves it in FIFO order to a consumer-local list, from which it pops
+ * without any synchronization.
+ */
 class CommandQueue
 {
 public:
-    /** Thread-safe buffer queue. */
-    lunchbox::MTQueue< co::ICommand > commands;
+    struct Node
+    {
+        Node( const co::ICommand& command_ ) : command( command_ ), next( 0 ) {}
+
+        co::ICommand command;
+        Node* next;
+    };
+
+    CommandQueue()
+        : back( 0 )
+        , front( 0 )
+        , head( 0 )
+        , tail( 0 )
+        , size( 0 )
+        , waiting( 0 )
+        , spins( _minSpins )
+    {}
+
+    ~CommandQueue()
+    {
+        clear();
+    }
+
+    void push( const co::ICommand& command, Node* volatile& stack )
+    {
+        Node* node = new Node( command );
+        if( CommandStats::isEnabled( ))
+            node->command.setQueueTime( CommandStats::getTime( ));
+        ++size;
+        do
+        {
+            node->next = stack;
+        }
+        while( !lunchbox::compareAndSwap( &stack, node->next, node ));
+
+        lunchbox::memoryBarrier();
+        if( waiting == 0 )
+            return;
+
+        condition.lock();
+        condition.signal();
+        condition.unlock();
+    }
+
+    /** Move all pushed commands to the local list. @return !empty. */
+    bool fetch()
+    {
+        // pushFront stack is in pop order, prepend as is
+        Node* node = _take( front );
+        if( node )
+        {
+            Node* last = node;
+            while( last->next )
+                last = last->next;
+            last->next = head;
+            if( !head )
+                tail = last;
+            head = node;
+        }
+
+        // push stack is in reverse order, reverse and append
+        node = _take( back );
+        if( node )
+        {
+            Node* first = 0;
+            Node* last = node;
+            while( node )
+            {
+                Node* next = node->next;
+                node->next = first;
+                first = node;
+                node = next;
+            }
+            if( tail )
+                tail->next = first;
+            else
+                head = first;
+            tail = last;
+        }
+        return head != 0;
+    }
+
+    /** Spin, then block until a command is available. @return !timeout. */
+    bool wait( const uint32_t timeout )
+    {
+        for( uint32_t i = 0; i < spins; ++i )
+        {
+            if( fetch( ))
+            {
+                spins = LB_MIN( spins << 1, _maxSpins );
+                return true;
+            }
+        }
+        spins = LB_MAX( spins >> 1, _minSpins );
+
+        condition.lock();
+        ++waiting;
+        lunchbox::memoryBarrier();
+
+        bool ok = true;
+        while( !fetch( ))
+        {
+            if( timeout == LB_TIMEOUT_INDEFINITE )
+                condition.wait();
+            else if( !condition.timedWait( timeout ))
+            {
+                ok = fetch();
+                break;
+            }
+        }
+
+        --waiting;
+        condition.unlock();
+        return ok;
+    }
+
+    co::ICommand pop()
+    {
+        LBASSERT( head );
+        Node* node = head;
+        head = node->next;
+        if( !head )
+            tail = 0;
+
+        const co::ICommand command = node->command;
+        delete node;
+        --size;
+        return command;
+    }
+
+    void clear()
+    {
+        fetch();
+        while( head )
+            pop();
+    }
+
+    /** Pushed commands in reverse order, written by all threads. */
+    Node* volatile back;
+
+    /** Commands pushed to the front in pop order, written by all threads. */
+    Node* volatile front;
+
+    Node* head; //!< local commands in pop order, consumer only
+    Node* tail; //!< last local command, consumer only
+
+    lunchbox::a_int32_t size;
+    lunchbox::a_int32_t waiting; //!< consumer blocks on condition
+    lunchbox::Condition condition;
+    uint32_t spins; //!< spin iterations before blocking, consumer only
+
+private:
+    static Node* _take( Node* volatile& stack )
+    {
+        Node* node = stack;
+        while( node && !lunchbox::compareAndSwap( &stack, node, (Node*)0 ))
+            node = stack;
+        return node;
+    }
 };
 }
 
@@ -51,48 +223,60 @@ void CommandQueue::flush()
     if( !isEmpty( ))
         LBWARN << "Flushing non-empty command queue" << std::endl;
 
-    _impl->commands.clear();
+    _impl->clear();
 }
 
 bool CommandQueue::isEmpty() const
 {
-    return _impl->commands.isEmpty();
+    return _impl->size == 0;
 }
 
 size_t CommandQueue::getSize() const
 {
-    return _impl->commands.getSize();
+    return size_t( int32_t( _impl->size ));
 }
 
 void CommandQueue::push( const ICommand& command )
 {
-    _impl->commands.push( command );
+    _impl->push( command, _impl->back );
 }
 
 void CommandQueue::pushFront( const ICommand& command )
 {
     LBASSERT( command.isValid( ));
-    _impl->commands.pushFront( command );
+    _impl->push( command, _impl->front );
 }
 
 ICommand CommandQueue::pop( const uint32_t timeout )
 {
     LB_TS_THREAD( _thread );
 
-    ICommand command;
-    if( !_impl->commands.timedPop( timeout, command ))
+    if( !_impl->head && !_impl->fetch() && !_impl->wait( timeout ))
         throw Exception( Exception::TIMEOUT_COMMANDQUEUE );
 
-    return command;
+    return _impl->pop();
 }
 
 ICommand CommandQueue::tryPop()
 {
     LB_TS_THREAD( _thread );
-    ICommand command;
-    _impl->commands.tryPop( command );
-    return command;
+    if( !_impl->head && !_impl->fetch( ))
+        return ICommand();
+    return _impl->pop();
 }
 
+size_t CommandQueue::popAll( ICommands& commands )
+{
+    LB_TS_THREAD( _thread );
+    _impl->fetch();
+
+    size_t nCommands = 0;
+    while( _impl->head )
+    {
+        commands.push_back( _impl->pop( ));
+        ++nCommands;
+    }
+    return nCommands;
 }
 
+}
@@ -26,7 +26,14 @@ namespace co
 {
 namespace detail { class CommandQueue; }
 
-    /** A thread-safe queue for ICommand buffers. */
+    /**
+     * A thread-safe queue for ICommand buffers.
+     *
+     * The queue is lock-free for any number of pushing threads and a single
+     * popping thread. A popping thread spins for a short, adaptive time before
+     * blocking on an empty queue. Users popping from several threads have to
+     * serialize the pop(), tryPop() and popAll() calls.
+     */
     class CommandQueue : public lunchbox::NonCopyable
     {
     public:
@@ -66,6 +73,15 @@ namespace detail { class CommandQueue; }
          */
         CO_API virtual ICommand tryPop();
 
+        /**
+         * Pop all queued commands without blocking.
+         *
+         * @param commands the vector to append the commands to.
+         * @return the number of appended commands.
+         * @version 1.0
+         */
+        CO_API virtual size_t popAll( ICommands& commands );
+
         /**
          * @return <code>true</code> if the command queue is empty,
          *         <code>false</code> if not.
@@ -0,0 +1,236 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "commandStats.h"
+
+#include "commands.h"
+#include "global.h"
+
+#include <lunchbox/clock.h>
+#include <lunchbox/lock.h>
+#include <lunchbox/perThread.h>
+#include <lunchbox/scopedMutex.h>
+#include <lunchbox/spinLock.h>
+#include <lunchbox/stdExt.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+namespace co
+{
+namespace
+{
+typedef stde::hash_map< uint64_t, CommandStats::Entry > EntryHash;
+typedef EntryHash::const_iterator EntryHashCIter;
+
+inline uint64_t _key( const uint32_t type, const uint32_t command )
+{
+    return ( uint64_t( type ) << 32 ) | command;
+}
+
+void _merge( EntryHash& to, const EntryHash& from )
+{
+    for( EntryHashCIter i = from.begin(); i != from.end(); ++i )
+    {
+        const CommandStats::Entry& entry = i->second;
+        CommandStats::Entry& sum = to[ i->first ];
+        sum.type = entry.type;
+        sum.command = entry.command;
+        sum.count += entry.count;
+        sum.bytes += entry.bytes;
+        sum.queueTime.merge( entry.queueTime );
+        sum.handlerTime.merge( entry.handlerTime );
+    }
+}
+
+bool _less( const CommandStats::Entry& lhs, const CommandStats::Entry& rhs )
+{
+    return _key( lhs.type, lhs.command ) < _key( rhs.type, rhs.command );
+}
+
+class ThreadStats;
+typedef std::vector< ThreadStats* > ThreadStatsVector;
+
+// Declared before _threadStats, since thread statistics use them on deletion
+lunchbox::Clock _clock;
+lunchbox::Lock _lock;
+ThreadStatsVector _threads; //!< the statistics of all running threads
+EntryHash _exited;          //!< the statistics of all exited threads
+
+/** The statistics recorded by one thread. */
+class ThreadStats
+{
+public:
+    ThreadStats()
+    {
+        lunchbox::ScopedMutex<> mutex( _lock );
+        _threads.push_back( this );
+    }
+
+    ~ThreadStats()
+    {
+        lunchbox::ScopedMutex<> mutex( _lock );
+        _threads.erase( std::find( _threads.begin(), _threads.end(), this ));
+        _merge( _exited, entries );
+    }
+
+    lunchbox::SpinLock lock; //!< uncontended unless stats are read
+    EntryHash entries;
+};
+
+lunchbox::PerThread< ThreadStats > _threadStats;
+}
+
+CommandStats::Histogram::Histogram()
+{
+    ::memset( _buckets, 0, sizeof( _buckets ));
+}
+
+void CommandStats::Histogram::add( const int64_t duration )
+{
+    size_t bucket = 0;
+    for( int64_t i = duration; i > 0 && bucket < NUM_BUCKETS - 1; i >>= 1 )
+        ++bucket;
+    ++_buckets[ bucket ];
+}
+
+void CommandStats::Histogram::merge( const Histogram& rhs )
+{
+    for( size_t i = 0; i < NUM_BUCKETS; ++i )
+        _buckets[ i ] += rhs._buckets[ i ];
+}
+
+uint64_t CommandStats::Histogram::getCount() const
+{
+    uint64_t count = 0;
+    for( size_t i = 0; i < NUM_BUCKETS; ++i )
+        count += _buckets[ i ];
+    return count;
+}
+
+int64_t CommandStats::Histogram::getPercentile( const float percentile ) const
+{
+    const uint64_t count = getCount();
+    if( count == 0 )
+        return 0;
+
+    const uint64_t target = uint64_t( count * percentile / 100.f );
+    uint64_t sum = 0;
+    for( size_t i = 0; i < NUM_BUCKETS; ++i )
+    {
+        sum += _buckets[ i ];
+        if( sum > target )
+            return int64_t( 1 ) << i;
+    }
+    return int64_t( 1 ) << ( NUM_BUCKETS - 1 );
+}
+
+CommandStats::Entry::Entry()
+    : type( COMMANDTYPE_INVALID )
+    , command( CMD_INVALID )
+    , count( 0 )
+    , bytes( 0 )
+{}
+
+void CommandStats::update()
+{
+    EntryHash entries;
+    {
+        lunchbox::ScopedMutex<> mutex( _lock );
+        _merge( entries, _exited );
+        for( ThreadStatsVector::const_iterator i = _threads.begin();
+             i != _threads.end(); ++i )
+        {
+            ThreadStats* stats = *i;
+            lunchbox::ScopedFastRead statsMutex( stats->lock );
+            _merge( entries, stats->entries );
+        }
+    }
+
+    _entries.clear();
+    for( EntryHashCIter i = entries.begin(); i != entries.end(); ++i )
+        _entries.push_back( i->second );
+    std::sort( _entries.begin(), _entries.end(), _less );
+}
+
+void CommandStats::reset()
+{
+    lunchbox::ScopedMutex<> mutex( _lock );
+    _exited.clear();
+    for( ThreadStatsVector::const_iterator i = _threads.begin();
+         i != _threads.end(); ++i )
+    {
+        ThreadStats* stats = *i;
+        lunchbox::ScopedFastWrite statsMutex( stats->lock );
+        stats->entries.clear();
+    }
+}
+
+int64_t CommandStats::getTime()
+{
+    return int64_t( _clock.getTimed() * 1000. );
+}
+
+bool CommandStats::isEnabled()
+{
+    return Global::getIAttribute( Global::IATTR_COMMAND_STATS ) != 0;
+}
+
+void CommandStats::record( const uint32_t type, const uint32_t command,
+                           const uint64_t size, const int64_t queueTime,
+                           const int64_t handlerTime )
+{
+    ThreadStats* stats = _threadStats.get();
+    if( !stats )
+    {
+        stats = new ThreadStats;
+        _threadStats = stats;
+    }
+
+    lunchbox::ScopedFastWrite mutex( stats->lock );
+    Entry& entry = stats->entries[ _key( type, command ) ];
+    entry.type = type;
+    entry.command = command;
+    ++entry.count;
+    entry.bytes += size;
+    if( queueTime >= 0 )
+        entry.queueTime.add( queueTime );
+    entry.handlerTime.add( handlerTime );
+}
+
+std::ostream& operator << ( std::ostream& os, const CommandStats& stats )
+{
+    os << "  type    cmd      count      bytes  queue p50/p99 us  "
+       << "handler p50/p99 us" << std::endl;
+
+    const CommandStats::Entries& entries = stats.getEntries();
+    for( CommandStats::Entries::const_iterator i = entries.begin();
+         i != entries.end(); ++i )
+    {
+        const CommandStats::Entry& entry = *i;
+        os << std::setw( 6 ) << entry.type << std::setw( 7 ) << entry.command
+           << std::setw( 11 ) << entry.count << std::setw( 11 ) << entry.bytes
+           << std::setw( 9 ) << entry.queueTime.getPercentile( 50.f ) << '/'
+           << std::setw( 8 ) << std::left
+           << entry.queueTime.getPercentile( 99.f ) << std::right
+           << std::setw( 11 ) << entry.handlerTime.getPercentile( 50.f ) << '/'
+           << entry.handlerTime.getPercentile( 99.f ) << std::endl;
+    }
+    return os;
+}
+
+}
@@ -0,0 +1,128 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CO_COMMANDSTATS_H
+#define CO_COMMANDSTATS_H
+
+#include <co/api.h>
+#include <co/types.h>
+
+#include <iostream>
+#include <vector>
+
+namespace co
+{
+    /**
+     * Dispatch statistics of all commands handled by the process.
+     *
+     * For each command type and command, the number of handled commands, their
+     * size, the time they spent in a CommandQueue and the execution time of
+     * their handler are recorded. The statistics are collected per thread and
+     * merged when they are retrieved.
+     *
+     * @sa LocalNode::getCommandStats(), Global::IATTR_COMMAND_STATS
+     */
+    class CommandStats
+    {
+    public:
+        /**
+         * A log-scale histogram of durations in microseconds.
+         *
+         * Bucket 0 counts durations below one microsecond, bucket i durations
+         * in [2^(i-1), 2^i) microseconds.
+         */
+        class Histogram
+        {
+        public:
+            enum { NUM_BUCKETS = 32 };
+
+            CO_API Histogram();
+
+            /** Add one duration in microseconds. @version 1.0 */
+            CO_API void add( const int64_t duration );
+
+            /** Add all durations of the given histogram. @version 1.0 */
+            CO_API void merge( const Histogram& rhs );
+
+            /** @return the number of durations. @version 1.0 */
+            CO_API uint64_t getCount() const;
+
+            /**
+             * @return the upper bound of the bucket containing the given
+             *         percentile, in microseconds.
+             * @version 1.0
+             */
+            CO_API int64_t getPercentile( const float percentile ) const;
+
+            /** @return the count of the given bucket. @version 1.0 */
+            uint64_t getBucket( const size_t i ) const { return _buckets[ i ]; }
+
+        private:
+            uint64_t _buckets[ NUM_BUCKETS ];
+        };
+
+        /** The statistics of one command. */
+        struct Entry
+        {
+            CO_API Entry();
+
+            uint32_t type;       //!< the command type
+            uint32_t command;    //!< the command
+            uint64_t count;      //!< the number of handled commands
+            uint64_t bytes;      //!< the total size of the commands
+            Histogram queueTime; //!< from queue push to handler invocation
+            Histogram handlerTime; //!< handler execution
+        };
+        typedef std::vector< Entry > Entries;
+
+        /** @return the statistics, sorted by command type and command. */
+        const Entries& getEntries() const { return _entries; }
+
+        /** @internal Collect the current statistics of all threads. */
+        CO_API void update();
+
+        /** @internal Clear the statistics of all threads. */
+        CO_API static void reset();
+
+        /** @internal @return the current time in microseconds. */
+        static int64_t getTime();
+
+        /** @internal @return true if statistics are recorded. */
+        static bool isEnabled();
+
+        /**
+         * @internal
+         * Record a handled command for the calling thread.
+         *
+         * @param type the command type.
+         * @param command the command.
+         * @param size the command size.
+         * @param queueTime the queuing time, or -1 if it was not queued.
+         * @param handlerTime the handler execution time.
+         */
+        static void record( const uint32_t type, const uint32_t command,
+                            const uint64_t size, const int64_t queueTime,
+                            const int64_t handlerTime );
+
+    private:
+        Entries _entries;
+    };
+
+    /** Print the command statistics as a table. */
+    CO_API std::ostream& operator << ( std::ostream& os,
+                                       const CommandStats& stats );
+}
+#endif // CO_COMMANDSTATS_H
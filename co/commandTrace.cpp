@@ -0,0 +1,168 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "commandTrace.h"
+
+#include "global.h"
+#include "iCommand.h"
+#include "localNode.h"
+
+#include <lunchbox/scopedMutex.h>
+
+namespace co
+{
+namespace
+{
+enum Lane
+{
+    LANE_NETWORK,
+    LANE_RECEIVE,
+    LANE_QUEUE,
+    LANE_HANDLER
+};
+
+const char* const _laneNames[] = { "network", "receive", "queue", "handler" };
+
+void _writeEvent( std::ostream& os, const CommandTrace::Record& record,
+                  const Lane lane, const int64_t begin, const int64_t end )
+{
+    if( begin < 0 || end < begin )
+        return;
+
+    os << ",\n{\"name\":\"" << record.type << '.' << record.command
+       << "\",\"cat\":\"" << _laneNames[ lane ] << "\",\"ph\":\"X\",\"ts\":"
+       << begin << ",\"dur\":" << end - begin << ",\"pid\":0,\"tid\":"
+       << int( lane ) << ",\"args\":{\"from\":\"" << record.node
+       << "\",\"size\":" << record.size << "}}";
+}
+}
+
+CommandTrace::CommandTrace()
+    : _next( 0 )
+    , _full( false )
+{}
+
+bool CommandTrace::isEnabled()
+{
+    return Global::getIAttribute( Global::IATTR_COMMAND_TRACE ) > 0;
+}
+
+void CommandTrace::record( const ICommand& command, const uint32_t type,
+                           const uint32_t cmd, const int64_t dequeue,
+                           const int64_t done )
+{
+    LocalNodePtr localNode = command.getLocalNode();
+    if( !localNode || !command.isTraced( ))
+        return;
+
+    NodePtr node = command.getNode();
+    const Record record = { node ? node->getNodeID() : NodeID::ZERO,
+                            type, cmd,
+                            command.getSize_(), command.getSendTime(),
+                            command.getReceiveTime(),
+                            command.getDispatchTime(), dequeue, done };
+    localNode->getCommandTrace().add( record );
+}
+
+void CommandTrace::add( const Record& record )
+{
+    lunchbox::ScopedMutex<> mutex( _lock );
+    const size_t size = Global::getIAttribute( Global::IATTR_COMMAND_TRACE );
+    if( _records.size() != size )
+    {
+        _records.resize( size );
+        _next = 0;
+        _full = false;
+    }
+    if( size == 0 )
+        return;
+
+    _records[ _next ] = record;
+    if( ++_next == size )
+    {
+        _next = 0;
+        _full = true;
+    }
+}
+
+void CommandTrace::addClockOffset( const NodeID& nodeID, const int64_t offset,
+                                   const int64_t rtt )
+{
+    lunchbox::ScopedMutex<> mutex( _lock );
+    ClockOffsets::iterator i = _offsets.find( nodeID );
+    if( i == _offsets.end( ))
+    {
+        const ClockOffset sample = { offset, rtt };
+        _offsets[ nodeID ] = sample;
+        return;
+    }
+
+    ClockOffset& best = i->second;
+    if( rtt > best.rtt )
+        return;
+
+    best.offset = offset;
+    best.rtt = rtt;
+}
+
+int64_t CommandTrace::getClockOffset( const NodeID& nodeID ) const
+{
+    lunchbox::ScopedMutex<> mutex( _lock );
+    ClockOffsets::const_iterator i = _offsets.find( nodeID );
+    return i == _offsets.end() ? 0 : i->second.offset;
+}
+
+void CommandTrace::write( std::ostream& os, const NodeID& localNodeID ) const
+{
+    lunchbox::ScopedMutex<> mutex( _lock );
+
+    os << "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\","
+       << "\"pid\":0,\"args\":{\"name\":\"" << localNodeID << "\"}}";
+    for( int lane = LANE_NETWORK; lane <= LANE_HANDLER; ++lane )
+        os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+           << lane << ",\"args\":{\"name\":\"" << _laneNames[ lane ] << "\"}}";
+
+    const size_t nRecords = _full ? _records.size() : _next;
+    const size_t first = _full ? _next : 0;
+    for( size_t i = 0; i < nRecords; ++i )
+    {
+        const Record& record = _records[ ( first + i ) % _records.size() ];
+        ClockOffsets::const_iterator j = _offsets.find( record.node );
+        const bool local = record.node == localNodeID;
+
+        if( local || j != _offsets.end( ))
+        {
+            const int64_t send = local ? record.send :
+                                         record.send - j->second.offset;
+            _writeEvent( os, record, LANE_NETWORK, send, record.receive );
+        }
+        _writeEvent( os, record, LANE_RECEIVE, record.receive,
+                     record.dispatch );
+        if( record.dequeue >= 0 )
+        {
+            _writeEvent( os, record, LANE_QUEUE, record.dispatch,
+                         record.dequeue );
+            _writeEvent( os, record, LANE_HANDLER, record.dequeue,
+                         record.done );
+        }
+        else
+            _writeEvent( os, record, LANE_HANDLER, record.dispatch,
+                         record.done );
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+}
+
+}
@@ -0,0 +1,123 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CO_COMMANDTRACE_H
+#define CO_COMMANDTRACE_H
+
+#include <co/api.h>
+#include <co/types.h>
+
+#include <lunchbox/lock.h>   // member
+#include <lunchbox/stdExt.h> // member
+
+#include <iostream>
+#include <vector>
+
+namespace co
+{
+    /**
+     * @internal
+     * A ring buffer of end-to-end command latency traces.
+     *
+     * Traced commands carry their send time in the command header, flagged by
+     * COMMANDTYPE_TRACED. The receiving node stamps the receive, dispatch,
+     * dequeue and handler completion time. All times are in microseconds of
+     * the process clock, see CommandStats::getTime(). Send times are
+     * converted using the clock offset to the sending node, which is estimated
+     * from ping round trips.
+     */
+    class CommandTrace
+    {
+    public:
+        /** Flags the send time following the command header. */
+        enum { COMMANDTYPE_TRACED = 1u << 30 };
+
+        /** The trace of one handled command. */
+        struct Record
+        {
+            NodeID node;      //!< the sending node
+            uint32_t type;
+            uint32_t command;
+            uint64_t size;
+            int64_t send;     //!< in the clock of the sending node
+            int64_t receive;
+            int64_t dispatch;
+            int64_t dequeue;  //!< -1 if not queued
+            int64_t done;
+        };
+        typedef std::vector< Record > Records;
+
+        /** Construct a new, empty trace. */
+        CommandTrace();
+
+        /** @return true if commands are traced, see IATTR_COMMAND_TRACE. */
+        static bool isEnabled();
+
+        /**
+         * Record a handled, traced command to the trace of its local node.
+         *
+         * @param command the command.
+         * @param type the command type before handling.
+         * @param cmd the command before handling.
+         * @param dequeue the time its handler was invoked from a queue, or -1.
+         * @param done the time its handler finished.
+         */
+        static void record( const ICommand& command, const uint32_t type,
+                            const uint32_t cmd, const int64_t dequeue,
+                            const int64_t done );
+
+        /** Add a record, overwriting the oldest one if full. */
+        void add( const Record& record );
+
+        /**
+         * Add a clock offset sample for the given node.
+         *
+         * The offset of the sample with the best round trip time is kept.
+         *
+         * @param nodeID the remote node.
+         * @param offset the remote minus the local clock.
+         * @param rtt the round trip time of the sample.
+         */
+        void addClockOffset( const NodeID& nodeID, const int64_t offset,
+                             const int64_t rtt );
+
+        /** @return the clock offset to the given node, 0 if unknown. */
+        int64_t getClockOffset( const NodeID& nodeID ) const;
+
+        /**
+         * Write all records in the Chrome trace event JSON format.
+         *
+         * @param os the output stream.
+         * @param localNodeID the identifier of the tracing node.
+         */
+        void write( std::ostream& os, const NodeID& localNodeID ) const;
+
+    private:
+        struct ClockOffset
+        {
+            int64_t offset;
+            int64_t rtt;
+        };
+        typedef stde::hash_map< uint128_t, ClockOffset > ClockOffsets;
+
+        mutable lunchbox::Lock _lock;
+        Records _records;
+        size_t _next;
+        bool _full;
+        ClockOffsets _offsets;
+    };
+}
+#endif // CO_COMMANDTRACE_H
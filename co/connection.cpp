@@ -21,6 +21,7 @@
 #include "buffer.h"
 #include "connectionDescription.h"
 #include "connectionListener.h"
+#include "connectionStats.h"
 #include "log.h"
 #include "pipeConnection.h"
 #include "socketConnection.h"
@@ -42,7 +43,10 @@
 #  include "udtConnection.h"
 #endif
 
+#include <lunchbox/atomic.h>
+#include <lunchbox/clock.h>
 #include <lunchbox/scopedMutex.h>
+#include <lunchbox/spinLock.h>
 #include <lunchbox/stdExt.h>
 
 //#define STATISTICS
@@ -69,6 +73,13 @@ lunchbox::Lockable< Histogram, lunchbox::SpinLock > _histogram;
 #  define DUMP_STATISTIC
 #endif
 
+namespace
+{
+lunchbox::Clock _clock;
+inline uint64_t _getMicroSeconds()
+    { return uint64_t( _clock.getTimed() * 1000. ); }
+}
+
 namespace co
 {
 namespace detail
@@ -82,6 +93,13 @@ public:
     /** The lock used to protect concurrent write calls. */
     mutable lunchbox::Lock sendLock;
 
+    /** The I/O statistics, without the send queue depth. */
+    mutable ConnectionStats stats;
+    mutable lunchbox::SpinLock statsLock;
+
+    /** The threads currently sending or waiting for sendLock. */
+    mutable lunchbox::a_int32_t sendQueueDepth;
+
     BufferPtr buffer; //!< Current async read buffer
     uint64_t bytes; //!< Current read request size
 
@@ -91,6 +109,7 @@ public:
     Connection()
             : state( co::Connection::STATE_CLOSED )
             , description( new ConnectionDescription )
+            , sendQueueDepth( 0 )
             , bytes( 0 )
     {
         description->type = CONNECTIONTYPE_NONE;
@@ -217,12 +236,27 @@ void Connection::_setState( const State state )
 
 void Connection::lockSend() const
 {
+    ++_impl->sendQueueDepth;
+    const uint64_t start = _getMicroSeconds();
     _impl->sendLock.set();
+
+    const uint64_t lockTime = _getMicroSeconds() - start;
+    lunchbox::ScopedFastWrite mutex( _impl->statsLock );
+    _impl->stats.sendLockTime += lockTime;
 }
 
 void Connection::unlockSend() const
 {
     _impl->sendLock.unset();
+    --_impl->sendQueueDepth;
+}
+
+ConnectionStats Connection::getStats() const
+{
+    lunchbox::ScopedFastRead mutex( _impl->statsLock );
+    ConnectionStats stats = _impl->stats;
+    stats.sendQueueDepth = LB_MAX( int32_t( _impl->sendQueueDepth ), 0 );
+    return stats;
 }
 
 void Connection::addListener( ConnectionListener* listener )
@@ -274,6 +308,7 @@ bool Connection::recvSync( BufferPtr& outBuffer, const bool block )
     // 'Iterators' for receive loop
     uint8_t* ptr = outBuffer->getData() + outBuffer->getSize();
     uint64_t bytesLeft = bytes;
+    uint64_t partialReads = 0;
     int64_t got = readSync( ptr, bytesLeft, block );
 
     // WAR: fluke notification: On Win32, we get occasionally a data
@@ -313,6 +348,7 @@ bool Connection::recvSync( BufferPtr& outBuffer, const bool block )
         }
         if( bytesLeft > static_cast< uint64_t >( got )) // partial read
         {
+            ++partialReads;
             ptr += got;
             bytesLeft -= got;
 
@@ -326,6 +362,12 @@ bool Connection::recvSync( BufferPtr& outBuffer, const bool block )
                       got << " != " << bytesLeft );
 
         outBuffer->resize( outBuffer->getSize() + bytes );
+        {
+            lunchbox::ScopedFastWrite mutex( _impl->statsLock );
+            _impl->stats.bytesReceived += bytes;
+            ++_impl->stats.receives;
+            _impl->stats.partialReads += partialReads;
+        }
 #ifndef NDEBUG
         if( bytes <= 1024 && ( lunchbox::Log::topics & LOG_PACKETS ))
         {
@@ -364,6 +406,41 @@ BufferPtr Connection::resetRecvData()
 //----------------------------------------------------------------------
 // write
 //----------------------------------------------------------------------
+namespace
+{
+/** Updates the send statistics when leaving Connection::send(). */
+class SendStatistics
+{
+public:
+    SendStatistics( detail::Connection& impl, const uint64_t bytes,
+                    const uint64_t lockStart, const bool isLocked )
+        : _impl( impl ), _bytes( bytes ), _lockStart( lockStart )
+        , _writeStart( _getMicroSeconds( )), _isLocked( isLocked )
+    {}
+
+    ~SendStatistics()
+    {
+        const uint64_t now = _getMicroSeconds();
+        {
+            lunchbox::ScopedFastWrite mutex( _impl.statsLock );
+            _impl.stats.bytesSent += _bytes;
+            ++_impl.stats.sends;
+            _impl.stats.sendLockTime += _writeStart - _lockStart;
+            _impl.stats.writeTime += now - _writeStart;
+        }
+        if( !_isLocked )
+            --_impl.sendQueueDepth;
+    }
+
+private:
+    detail::Connection& _impl;
+    const uint64_t _bytes;
+    const uint64_t _lockStart;
+    const uint64_t _writeStart;
+    const bool _isLocked;
+};
+}
+
 bool Connection::send( const void* buffer, const uint64_t bytes,
                        const bool isLocked )
 {
@@ -379,7 +456,11 @@ bool Connection::send( const void* buffer, const uint64_t bytes,
     // 1) Disassemble buffer into 'small enough' pieces and use a header to
     //    reassemble correctly on the other side (aka reliable UDP)
     // 2) Introduce a send thread with a thread-safe task queue
+    if( !isLocked )
+        ++_impl->sendQueueDepth;
+    const uint64_t lockStart = _getMicroSeconds();
     lunchbox::ScopedMutex<> mutex( isLocked ? 0 : &_impl->sendLock );
+    SendStatistics statistics( *_impl, bytes, lockStart, isLocked );
 
 #ifndef NDEBUG
     if( bytes <= 1024 && ( lunchbox::Log::topics & LOG_PACKETS ))
@@ -441,6 +522,40 @@ ConnectionDescriptionPtr Connection::_getDescription()
     return _impl->description;
 }
 
+ConnectionStats::ConnectionStats()
+    : bytesSent( 0 )
+    , sends( 0 )
+    , sendLockTime( 0 )
+    , writeTime( 0 )
+    , bytesReceived( 0 )
+    , receives( 0 )
+    , partialReads( 0 )
+    , sendQueueDepth( 0 )
+{}
+
+ConnectionStats& ConnectionStats::operator += ( const ConnectionStats& rhs )
+{
+    bytesSent += rhs.bytesSent;
+    sends += rhs.sends;
+    sendLockTime += rhs.sendLockTime;
+    writeTime += rhs.writeTime;
+    bytesReceived += rhs.bytesReceived;
+    receives += rhs.receives;
+    partialReads += rhs.partialReads;
+    sendQueueDepth += rhs.sendQueueDepth;
+    return *this;
+}
+
+std::ostream& operator << ( std::ostream& os, const ConnectionStats& stats )
+{
+    return os << "sent " << stats.bytesSent << " bytes in " << stats.sends
+              << " calls, lock " << stats.sendLockTime << " us, write "
+              << stats.writeTime << " us, received " << stats.bytesReceived
+              << " bytes in " << stats.receives << " calls, "
+              << stats.partialReads << " partial reads, send queue "
+              << stats.sendQueueDepth;
+}
+
 std::ostream& operator << ( std::ostream& os, const Connection& connection )
 {
     Connection::State        state = connection.getState();
@@ -99,6 +99,13 @@ namespace detail { class Connection; }
         /** @return the description for this connection. @version 1.0 */
         CO_API ConstConnectionDescriptionPtr getDescription() const;
 
+        /**
+         * @return a snapshot of the I/O statistics of this connection.
+         * @sa ConnectionStats
+         * @version 1.0
+         */
+        CO_API ConnectionStats getStats() const;
+
         /** @internal */
         bool operator == ( const Connection& rhs ) const;
         //@}
@@ -0,0 +1,56 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CO_CONNECTIONSTATS_H
+#define CO_CONNECTIONSTATS_H
+
+#include <co/api.h>
+#include <co/types.h>
+
+#include <iostream>
+
+namespace co
+{
+    /**
+     * Runtime I/O statistics of a connection.
+     *
+     * Times are in microseconds.
+     * @sa Connection::getStats(), Node::getConnectionStats()
+     */
+    struct ConnectionStats
+    {
+        CO_API ConnectionStats();
+
+        uint64_t bytesSent;     //!< bytes passed to send()
+        uint64_t sends;         //!< number of send() calls
+        uint64_t sendLockTime;  //!< time waiting for the send lock
+        uint64_t writeTime;     //!< time in write() holding the send lock
+        uint64_t bytesReceived; //!< bytes read by recvSync()
+        uint64_t receives;      //!< number of completed recvSync() calls
+        uint64_t partialReads;  //!< reads returning less than requested
+
+        /** Threads currently sending or waiting for the send lock. */
+        uint32_t sendQueueDepth;
+
+        /** Add the given statistics. @version 1.0 */
+        CO_API ConnectionStats& operator += ( const ConnectionStats& rhs );
+    };
+
+    /** Print the connection statistics in one line. @version 1.0 */
+    CO_API std::ostream& operator << ( std::ostream& os,
+                                       const ConnectionStats& stats );
+}
+#endif // CO_CONNECTIONSTATS_H
@@ -98,28 +98,52 @@ void DataIStream::_reset()
 
 void DataIStream::_read( void* data, uint64_t size )
 {
-    if( !_checkBuffer( ))
-    {
-        LBUNREACHABLE;
-        LBERROR << "No more input data" << std::endl;
-        return;
-    }
-
-    LBASSERT( _impl->input );
-
-    if( _impl->position + size > _impl->inputSize )
+    // Reads may be asymmetric to writes and span multiple input buffers
+    uint8_t* ptr = static_cast< uint8_t* >( data );
+    while( size > 0 )
     {
-        LBERROR << "Not enough data in input buffer: need " << size
-                << " bytes, " << _impl->inputSize - _impl->position << " left "
-                << std::endl;
-        LBUNREACHABLE;
-        // TODO: Allow reads which are asymmetric to writes by reading from
-        // multiple blocks here?
-        return;
+        if( _impl->position >= _impl->inputSize )
+        {
+            uint32_t compressor = EQ_COMPRESSOR_NONE;
+            uint32_t nChunks = 0;
+            const void* chunkData = 0;
+            uint64_t dataSize = 0;
+
+            if( !getNextBuffer( compressor, nChunks, &chunkData, dataSize ))
+            {
+                LBERROR << "Not enough input data: need " << size
+                        << " more bytes" << std::endl;
+                LBUNREACHABLE;
+                return;
+            }
+
+            _impl->position = 0;
+            if( compressor != EQ_COMPRESSOR_NONE && dataSize <= size )
+            {
+                // OPT: The read covers the whole buffer, decompress directly
+                // into the destination
+                _decompress( chunkData, compressor, nChunks, dataSize, ptr );
+                _impl->input = 0;
+                _impl->inputSize = 0;
+                ptr += dataSize;
+                size -= dataSize;
+                continue;
+            }
+
+            _impl->input = _decompress( chunkData, compressor, nChunks,
+                                        dataSize );
+            _impl->inputSize = dataSize;
+            continue; // skip empty buffers
+        }
+
+        LBASSERT( _impl->input );
+        const uint64_t bytes = LB_MIN( size,
+                                       _impl->inputSize - _impl->position );
+        memcpy( ptr, _impl->input + _impl->position, bytes );
+        _impl->position += bytes;
+        ptr += bytes;
+        size -= bytes;
     }
-
-    memcpy( data, _impl->input + _impl->position, size );
-    _impl->position += size;
 }
 
 const void* DataIStream::getRemainingBuffer( const uint64_t size )
@@ -135,6 +159,17 @@ const void* DataIStream::getRemainingBuffer( const uint64_t size )
     return _impl->input + _impl->position - size;
 }
 
+const void* DataIStream::getNextView( const uint64_t maxSize, uint64_t& size )
+{
+    size = 0;
+    if( maxSize == 0 || !_checkBuffer( ))
+        return 0;
+
+    size = LB_MIN( maxSize, _impl->inputSize - _impl->position );
+    _impl->position += size;
+    return _impl->input + _impl->position - size;
+}
+
 uint64_t DataIStream::getRemainingBufferSize()
 {
     if( !_checkBuffer( ))
@@ -174,7 +209,15 @@ const uint8_t* DataIStream::_decompress( const void* data, const uint32_t name,
     _impl->data.clear();
 #endif
     _impl->data.reset( dataSize );
+    _decompress( data, name, nChunks, dataSize, _impl->data.getData( ));
+    return _impl->data.getData();
+}
 
+void DataIStream::_decompress( const void* data, const uint32_t name,
+                               const uint32_t nChunks, const uint64_t dataSize,
+                               void* result )
+{
+    const uint8_t* src = reinterpret_cast< const uint8_t* >( data );
     if ( !_impl->decompressor.isValid( name ) )
         _impl->decompressor.initDecompressor( name );
 
@@ -195,9 +238,8 @@ const uint8_t* DataIStream::_decompress( const void* data, const uint32_t name,
         src += size;
     }
 
-    _impl->decompressor.decompress( chunks, chunkSizes, nChunks,
-                                    _impl->data.getData(), outDim );
-    return _impl->data.getData();
+    _impl->decompressor.decompress( chunks, chunkSizes, nChunks, result,
+                                    outDim );
 }
 
 }
@@ -119,13 +119,36 @@ namespace detail { class DataIStream; }
          * this function. However, a write operation on the other end is never
          * segmented, that is, if the application writes n bytes to the
          * DataOStream, a symmetric read from the DataIStream has at least n
-         * bytes available.
+         * bytes available. Use getNextView() to access data spanning multiple
+         * blocks.
          *
          * @param size the number of bytes to advance the buffer
          * @version 1.0
          */
         CO_API const void* getRemainingBuffer( const uint64_t size );
 
+        /**
+         * Get a zero-copy view on the next part of the remaining data.
+         *
+         * The stream is advanced by at most maxSize bytes, limited by the end
+         * of the current block. Calling this method in a loop consumes data
+         * spanning multiple blocks without copying it:
+         * @code
+         * for( uint64_t left = nBytes; left > 0; left -= size )
+         *     consume( is.getNextView( left, size ), size );
+         * @endcode
+         *
+         * As for getRemainingBuffer(), no endian conversion is performed. The
+         * returned memory is valid until the next read from this stream.
+         *
+         * @param maxSize the maximum number of bytes to advance the stream.
+         * @param size returns the number of bytes available at the view.
+         * @return the view on the data, or 0 if no data is left.
+         * @version 1.0
+         */
+        CO_API const void* getNextView( const uint64_t maxSize,
+                                        uint64_t& size );
+
         /**
          * @return the size of the remaining data in the current buffer.
          * @version 1.0
@@ -149,6 +172,11 @@ namespace detail { class DataIStream; }
 
         virtual bool getNextBuffer( uint32_t& compressor, uint32_t& nChunks,
                                     const void** chunkData, uint64_t& size )=0;
+
+        /** @internal Decompress the given chunks into the result buffer. */
+        void _decompress( const void* data, const uint32_t name,
+                          const uint32_t nChunks, const uint64_t dataSize,
+                          void* result );
     private:
         detail::DataIStream* const _impl;
 
@@ -28,13 +28,18 @@ namespace co
     {
         uint64_t nElems = 0;
         *this >> nElems;
-        LBASSERTINFO( nElems <= getRemainingBufferSize(),
-                      nElems << " > " << getRemainingBufferSize( ));
+        LBASSERTINFO( nElems < LB_BIT48,
+                    "Out-of-sync co::DataIStream: " << nElems << " elements?" );
         if( nElems == 0 )
             str.clear();
-        else
+        else if( nElems <= getRemainingBufferSize( ))
             str.assign( static_cast< const char* >( getRemainingBuffer(nElems)),
                         size_t( nElems ));
+        else
+        {
+            str.resize( size_t( nElems ));
+            _read( &str[0], nElems );
+        }
         return *this;
     }
 
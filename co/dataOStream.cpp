@@ -28,6 +28,10 @@
 #include "node.h"
 #include "types.h"
 
+#include <lunchbox/atomic.h>
+#include <lunchbox/lock.h>
+#include <lunchbox/lockable.h>
+#include <lunchbox/scopedMutex.h>
 
 namespace co
 {
@@ -43,6 +47,22 @@ CO_API lunchbox::a_int32_t nBytesSent;
 lunchbox::a_int32_t compressionTime;
 #endif
 
+// Sampling parameters for the incompressibility check
+static const uint64_t _sampleSize = 4096;
+static const uint64_t _nSamples = 4;
+static const uint64_t _minSampledSize = _sampleSize * _nSamples * 2;
+
+// Number of enabled streams (commits) not compressed after detecting
+// uncompressible data
+static const int32_t _nSkips = 16;
+
+enum CompressibilityState
+{
+    COMPRESSIBILITY_UNKNOWN,
+    COMPRESSIBILITY_COMPRESSIBLE,
+    COMPRESSIBILITY_UNCOMPRESSIBLE
+};
+
 enum CompressorState
 {
     STATE_UNCOMPRESSED,
@@ -50,6 +70,82 @@ enum CompressorState
     STATE_COMPLETE,
     STATE_UNCOMPRESSIBLE
 };
+
+/** A saved part of the stream data, sent as one command. */
+struct Segment
+{
+    Segment() : size( 0 ), state( STATE_UNCOMPRESSED )
+              , compressor( EQ_COMPRESSOR_NONE )
+              , nChunks( 0 ) {}
+
+    /** The raw data, or the compressed chunks as [size][data] sequence */
+    lunchbox::Bufferb data;
+    uint64_t size; //!< the uncompressed data size
+    CompressorState state; //!< COMPLETE if data holds compressed chunks
+    uint32_t compressor; //!< the compressor used for the data
+    uint32_t nChunks; //!< the number of compressed chunks
+};
+typedef std::vector< Segment* > Segments;
+typedef Segments::const_iterator SegmentsCIter;
+
+/** Process-wide pool of slab-sized segments. */
+class SegmentPool
+{
+public:
+    ~SegmentPool()
+    {
+        for( SegmentsCIter i = _free->begin(); i != _free->end(); ++i )
+            delete *i;
+    }
+
+    static size_t getSlabSize()
+        { return Global::getObjectBufferSize() + Buffer::getCacheSize(); }
+
+    Segment* alloc()
+    {
+        {
+            lunchbox::ScopedMutex<> mutex( _free );
+            if( !_free->empty( ))
+            {
+                Segment* segment = _free->back();
+                _free->pop_back();
+                return segment;
+            }
+        }
+        Segment* segment = new Segment;
+        segment->data.reserve( getSlabSize( ));
+        return segment;
+    }
+
+    void release( Segment* segment )
+    {
+        // Only recycle slabs, not small or single large write segments
+        const uint64_t maxSize = segment->data.getMaxSize();
+        if( maxSize < getSlabSize() || maxSize > getSlabSize() * 2 )
+        {
+            delete segment;
+            return;
+        }
+
+        segment->data.setSize( 0 );
+        segment->size = 0;
+        segment->state = STATE_UNCOMPRESSED;
+        segment->compressor = EQ_COMPRESSOR_NONE;
+        segment->nChunks = 0;
+
+        lunchbox::ScopedMutex<> mutex( _free );
+        if( _free->size() < _maxFree )
+            _free->push_back( segment );
+        else
+            delete segment;
+    }
+
+private:
+    static const size_t _maxFree = 256;
+    lunchbox::Lockable< Segments > _free;
+};
+
+static SegmentPool _segmentPool;
 }
 
 namespace detail
@@ -65,6 +161,15 @@ public:
     /** The start position of the buffering, always 0 if !_save */
     uint64_t bufferStart;
 
+    /** The data of the current sendData(), buffer or external segment */
+    const uint8_t* sendBuffer;
+
+    /** The saved segment of the current sendData(), if any */
+    const Segment* sendSegment;
+
+    /** Flushed data of a saving, segmented stream */
+    Segments segments;
+
     /** The uncompressed size of a completely compressed buffer. */
     uint64_t dataSize;
 
@@ -86,24 +191,75 @@ public:
     /** Save all sent data */
     bool save;
 
+    /** Save flushed data in segments instead of one contiguous buffer */
+    bool segmented;
+
+    /** Remaining streams to skip compression, possibly shared */
+    lunchbox::a_int32_t* skips;
+    lunchbox::a_int32_t ownSkips;
+
+    /** The compressibility of the data since the stream was enabled */
+    CompressibilityState compressibility;
+
     DataOStream()
             : state( STATE_UNCOMPRESSED )
             , bufferStart( 0 )
+            , sendBuffer( 0 )
+            , sendSegment( 0 )
             , dataSize( 0 )
             , enabled( false )
             , dataSent( false )
             , save( false )
+            , segmented( false )
+            , skips( &ownSkips )
+            , ownSkips( 0 )
+            , compressibility( COMPRESSIBILITY_UNKNOWN )
         {}
 
+    ~DataOStream() { clearSegments(); }
+
     uint32_t getCompressor() const
     {
+        if( sendSegment )
+            return sendSegment->state == STATE_COMPLETE ?
+                       sendSegment->compressor : EQ_COMPRESSOR_NONE;
         if( state == STATE_UNCOMPRESSED || state == STATE_UNCOMPRESSIBLE )
             return EQ_COMPRESSOR_NONE;
         return compressor.getName();
     }
 
+    /** @return true if flushed data is saved in segments. */
+    bool isSegmented() const { return save && segmented; }
+
+    void addSegment( Segment* segment )
+    {
+        segment->size = segment->data.getSize();
+        dataSize += segment->size;
+        segments.push_back( segment );
+    }
+
+    void clearSegments()
+    {
+        for( SegmentsCIter i = segments.begin(); i != segments.end(); ++i )
+            _segmentPool.release( *i );
+        segments.clear();
+    }
+
+    /**
+     * @return true if a write of the given size is sent from the caller's
+     *         memory instead of being copied into the buffer.
+     */
+    bool isReference( const uint64_t size ) const
+    {
+        return !save && !connections.empty() &&
+               size > Global::getObjectBufferSize();
+    }
+
     uint32_t getNumChunks() const
     {
+        if( sendSegment )
+            return sendSegment->state == STATE_COMPLETE ?
+                       sendSegment->nChunks : 1;
         if( state == STATE_UNCOMPRESSED || state == STATE_UNCOMPRESSIBLE )
             return 1;
         return compressor.getNumResults();
@@ -127,6 +283,12 @@ public:
             return;
         }
 
+        if( isUncompressible( src, size ))
+        {
+            state = STATE_UNCOMPRESSIBLE;
+            return;
+        }
+
         const uint64_t inDims[2] = { 0, size };
 
 #ifdef EQ_INSTRUMENT_DATAOSTREAM
@@ -155,6 +317,7 @@ public:
 
         if( compressedDataSize >= size )
         {
+            setUncompressible();
             state = STATE_UNCOMPRESSIBLE;
 #ifndef CO_AGGRESSIVE_CACHING
             const uint32_t name = compressor.getName();
@@ -176,6 +339,138 @@ public:
         }
 #endif
     }
+
+    /**
+     * Decide if the data of a newly enabled stream is compressed.
+     *
+     * Uncompressible data detected by a previous stream is assumed to continue
+     * for a number of streams, counted down atomically since the counter may
+     * be shared.
+     */
+    void resetCompressibility()
+    {
+        compressibility = COMPRESSIBILITY_UNKNOWN;
+        for( int32_t nSkips = *skips; nSkips > 0; nSkips = *skips )
+        {
+            if( skips->compareAndSwap( nSkips, nSkips - 1 ))
+            {
+                compressibility = COMPRESSIBILITY_UNCOMPRESSIBLE;
+                return;
+            }
+        }
+    }
+
+    /** Remember uncompressible data for this and the next streams. */
+    void setUncompressible()
+    {
+        compressibility = COMPRESSIBILITY_UNCOMPRESSIBLE;
+        *skips = _nSkips;
+    }
+
+    /**
+     * Check cheaply if the data is not worth compressing.
+     *
+     * The data is sampled once per enabled stream: a few blocks across the
+     * first large enough buffer are compressed to estimate the compression
+     * ratio, and the result is used for all further buffers of the stream.
+     */
+    bool isUncompressible( void* src, const uint64_t size )
+    {
+        if( compressibility != COMPRESSIBILITY_UNKNOWN )
+            return compressibility == COMPRESSIBILITY_UNCOMPRESSIBLE;
+
+        if( size < _minSampledSize )
+            return false;
+
+        const uint64_t step = ((size - _sampleSize) / (_nSamples - 1)) & ~7ull;
+        const uint64_t inDims[2] = { 0, _sampleSize };
+        uint64_t compressedSize = 0;
+
+        for( uint64_t i = 0; i < _nSamples; ++i )
+        {
+            compressor.compress( static_cast< uint8_t* >( src ) + i * step,
+                                 inDims );
+
+            const uint32_t nChunks = compressor.getNumResults();
+            for( uint32_t j = 0; j < nChunks; ++j )
+            {
+                void* chunk;
+                uint64_t chunkSize;
+                compressor.getResult( j, &chunk, &chunkSize );
+                compressedSize += chunkSize;
+            }
+        }
+
+        // compress only if the samples shrink by at least 1/8th
+        if( compressedSize * 8 < _sampleSize * _nSamples * 7 )
+        {
+            compressibility = COMPRESSIBILITY_COMPRESSIBLE;
+            return false;
+        }
+
+        setUncompressible();
+        return true;
+    }
+
+    /**
+     * Compress a saved segment once, replacing its data with the compressed
+     * chunks. Uncompressible segments are kept and sent as raw data.
+     */
+    void compress( Segment& segment )
+    {
+        if( segment.state != STATE_UNCOMPRESSED )
+            return;
+
+        segment.state = STATE_UNCOMPRESSIBLE;
+        const uint64_t threshold =
+           uint64_t( Global::getIAttribute( Global::IATTR_OBJECT_COMPRESSION ));
+        const uint32_t name = compressor.getName();
+        if( !compressor.isValid( name ) || segment.size <= threshold ||
+            isUncompressible( segment.data.getData(), segment.size ))
+        {
+            return;
+        }
+
+        const uint64_t inDims[2] = { 0, segment.size };
+        compressor.compress( segment.data.getData(), inDims );
+
+        const uint32_t nChunks = compressor.getNumResults();
+        uint64_t size = 0;
+        for( uint32_t i = 0; i < nChunks; ++i )
+        {
+            void* chunk;
+            uint64_t chunkSize;
+            compressor.getResult( i, &chunk, &chunkSize );
+            size += chunkSize;
+        }
+        if( size >= segment.size )
+        {
+            setUncompressible();
+            return;
+        }
+
+        lunchbox::Bufferb packed;
+        packed.reserve( size + nChunks * sizeof( uint64_t ));
+        for( uint32_t i = 0; i < nChunks; ++i )
+        {
+            void* chunk;
+            uint64_t chunkSize;
+            compressor.getResult( i, &chunk, &chunkSize );
+            packed.append( reinterpret_cast< const uint8_t* >( &chunkSize ),
+                           sizeof( uint64_t ));
+            packed.append( static_cast< const uint8_t* >( chunk ), chunkSize );
+        }
+
+        // recycle the raw data slab
+        Segment* raw = new Segment;
+        segment.data.swap( packed );
+        raw->data.swap( packed );
+        _segmentPool.release( raw );
+
+        segment.state = STATE_COMPLETE;
+        segment.compressor = name;
+        segment.nChunks = nChunks;
+    }
 };
 }
 
@@ -196,6 +491,11 @@ void DataOStream::_initCompressor( const uint32_t compressor )
     LB_TS_RESET( _impl->compressor._thread );
 }
 
+void DataOStream::_setCompressionSkips( lunchbox::a_int32_t& skips )
+{
+    _impl->skips = &skips;
+}
+
 void DataOStream::_enable()
 {
     LBASSERT( !_impl->enabled );
@@ -206,6 +506,8 @@ void DataOStream::_enable()
     _impl->dataSize    = 0;
     _impl->enabled     = true;
     _impl->buffer.setSize( 0 );
+    _impl->clearSegments();
+    _impl->resetCompressibility();
 #ifdef CO_AGGRESSIVE_CACHING
     _impl->buffer.reserve( Buffer::getCacheSize( ));
 #else
@@ -244,8 +546,22 @@ void DataOStream::_resend()
     LBASSERT( !_impl->connections.empty( ));
     LBASSERT( _impl->save );
 
+    if( _impl->isSegmented( ))
+    {
+        const size_t nSegments = _impl->segments.size();
+        for( size_t i = 0; i < nSegments; ++i )
+            _sendSegment( i, i + 1 == nSegments );
+
+        if( nSegments == 0 )
+        {
+            _impl->state = STATE_UNCOMPRESSED;
+            _sendData( 0, 0, true );
+        }
+        return;
+    }
+
     _impl->compress( _impl->buffer.getData(), _impl->dataSize, STATE_COMPLETE );
-    sendData( _impl->buffer.getData(), _impl->dataSize, true );
+    _sendData( _impl->buffer.getData(), _impl->dataSize, true );
 }
 
 void DataOStream::_clearConnections()
@@ -258,8 +574,14 @@ void DataOStream::disable()
     if( !_impl->enabled )
         return;
 
+    if( _impl->isSegmented( ))
+    {
+        _disableSegmented();
+        return;
+    }
+
     _impl->dataSize = _impl->buffer.getSize();
-    _impl->dataSent = _impl->dataSize > 0;
+    _impl->dataSent = _impl->dataSent || _impl->dataSize > 0;
 
     if( _impl->dataSent && !_impl->connections.empty( ))
     {
@@ -282,7 +604,7 @@ void DataOStream::disable()
             _impl->compress( ptr, size, state );
         }
 
-        sendData( ptr, size, true ); // always send to finalize istream
+        _sendData( ptr, size, true ); // always send to finalize istream
     }
 
 #ifndef CO_AGGRESSIVE_CACHING
@@ -293,6 +615,26 @@ void DataOStream::disable()
     _impl->connections.clear();
 }
 
+void DataOStream::_disableSegmented()
+{
+    if( !_impl->buffer.isEmpty( ))
+    {
+        _impl->dataSent = true;
+        _flushSegment( true );
+    }
+    else if( _impl->dataSent && !_impl->connections.empty( ))
+    {
+        _impl->state = STATE_UNCOMPRESSED;
+        _sendData( 0, 0, true ); // always send to finalize istream
+    }
+
+#ifndef CO_AGGRESSIVE_CACHING
+    _impl->buffer.clear();
+#endif
+    _impl->enabled = false;
+    _impl->connections.clear();
+}
+
 void DataOStream::enableSave()
 {
     LBASSERTINFO( !_impl->enabled ||
@@ -307,6 +649,13 @@ void DataOStream::disableSave()
                   (!_impl->dataSent && _impl->buffer.getSize() == 0 ),
                   "Can't disable saving after data has been written" );
     _impl->save = false;
+    _impl->segmented = false;
+}
+
+void DataOStream::enableSegmentedSave()
+{
+    enableSave();
+    _impl->segmented = true;
 }
 
 bool DataOStream::hasSentData() const
@@ -323,6 +672,18 @@ void DataOStream::_write( const void* data, uint64_t size )
         LBWARN << *this << std::endl;
 #endif
 
+    if( _impl->isReference( size ))
+    {
+        _writeReference( data, size );
+        return;
+    }
+
+    if( _impl->isSegmented() && size > Global::getObjectBufferSize( ))
+    {
+        _writeSegment( data, size );
+        return;
+    }
+
     if( _impl->buffer.getSize() - _impl->bufferStart >
         Global::getObjectBufferSize( ))
     {
@@ -331,17 +692,83 @@ void DataOStream::_write( const void* data, uint64_t size )
     _impl->buffer.append( static_cast< const uint8_t* >( data ), size );
 }
 
+void DataOStream::_writeReference( const void* data, const uint64_t size )
+{
+    // OPT: Large payloads are sent directly from the application memory,
+    // saving a copy into and a potential realloc of the buffer. The data is
+    // only referenced until sendData() returns, which sends it synchronously.
+    if( _impl->buffer.getSize() > _impl->bufferStart )
+        flush( false );
+
+    // The compressor API uses non-const source buffers
+    void* ptr = const_cast< void* >( data );
+    _impl->state = STATE_UNCOMPRESSED;
+    _impl->compress( ptr, size, STATE_PARTIAL );
+    _sendData( ptr, size, false );
+
+    _impl->dataSent = true;
+    _resetBuffer();
+}
+
+void DataOStream::_sendData( const void* data, const uint64_t size,
+                             const bool last )
+{
+    _impl->sendBuffer = static_cast< const uint8_t* >( data );
+    sendData( data, size, last );
+    _impl->sendBuffer = 0;
+}
+
+void DataOStream::_writeSegment( const void* data, const uint64_t size )
+{
+    // OPT: Large writes get their own segment, copying them only once. The
+    // segment is allocated with the exact size, bypassing the slab pool.
+    if( !_impl->buffer.isEmpty( ))
+        flush( false );
+
+    Segment* segment = new Segment;
+    segment->data.reserve( size );
+    segment->data.append( static_cast< const uint8_t* >( data ), size );
+    _impl->addSegment( segment );
+    if( !_impl->connections.empty( ))
+        _sendSegment( _impl->segments.size() - 1, false );
+
+    _impl->dataSent = true;
+    _resetBuffer();
+}
+
+void DataOStream::_flushSegment( const bool last )
+{
+    Segment* segment = _segmentPool.alloc();
+    segment->data.swap( _impl->buffer );
+    _impl->addSegment( segment );
+
+    if( !_impl->connections.empty( ))
+        _sendSegment( _impl->segments.size() - 1, last );
+}
+
+void DataOStream::_sendSegment( const size_t index, const bool last )
+{
+    Segment* segment = _impl->segments[ index ];
+    _impl->compress( *segment );
+
+    _impl->sendSegment = segment;
+    _sendData( segment->data.getData(), segment->size, last );
+    _impl->sendSegment = 0;
+}
+
 void DataOStream::flush( const bool last )
 {
     LBASSERT( _impl->enabled );
-    if( !_impl->connections.empty( ))
+    if( _impl->isSegmented( ))
+        _flushSegment( last );
+    else if( !_impl->connections.empty( ))
     {
         void* ptr = _impl->buffer.getData() + _impl->bufferStart;
         const uint64_t size = _impl->buffer.getSize() - _impl->bufferStart;
 
         _impl->state = STATE_UNCOMPRESSED;
         _impl->compress( ptr, size, STATE_PARTIAL );
-        sendData( ptr, size, last );
+        _sendData( ptr, size, last );
     }
     _impl->dataSent = true;
     _resetBuffer();
@@ -350,6 +777,7 @@ void DataOStream::flush( const bool last )
 void DataOStream::reset()
 {
     _resetBuffer();
+    _impl->clearSegments();
     _impl->enabled = false;
     _impl->connections.clear();
 }
@@ -393,6 +821,7 @@ uint64_t DataOStream::_getCompressedData( void** chunks, uint64_t* chunkSizes )
 
 lunchbox::Bufferb& DataOStream::getBuffer()
 {
+    LBASSERT( _impl->segments.empty( ));
     return _impl->buffer;
 }
 
@@ -407,9 +836,17 @@ void DataOStream::sendData( ConnectionPtr connection, const uint64_t dataSize )
     const uint32_t compressor = _impl->getCompressor();
     if( compressor == EQ_COMPRESSOR_NONE )
     {
+        LBASSERT( _impl->sendBuffer || dataSize == 0 );
         if( dataSize > 0 )
-            LBCHECK( connection->send( _impl->buffer.getData(), dataSize,
-                                       true ));
+            LBCHECK( connection->send( _impl->sendBuffer, dataSize, true ));
+        return;
+    }
+
+    const Segment* segment = _impl->sendSegment;
+    if( segment ) // compressed segments are stored in wire format
+    {
+        LBASSERT( dataSize == segment->data.getSize( ));
+        LBCHECK( connection->send( segment->data.getData(), dataSize, true ));
         return;
     }
 
@@ -438,6 +875,9 @@ void DataOStream::sendData( ConnectionPtr connection, const uint64_t dataSize )
 
 uint64_t DataOStream::getCompressedDataSize() const
 {
+    const Segment* segment = _impl->sendSegment;
+    if( segment && segment->state == STATE_COMPLETE )
+        return segment->data.getSize();
     if( _impl->getCompressor() == EQ_COMPRESSOR_NONE )
         return 0;
     return _impl->compressedDataSize
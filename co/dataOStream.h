@@ -55,6 +55,15 @@ namespace DataStreamTest { class Sender; }
         /** @internal Disable copying of all data into a saved buffer. */
         void disableSave();
 
+        /**
+         * @internal Enable saving of all data into a list of segments.
+         *
+         * Flushed data is kept in fixed-size slabs instead of one growing
+         * buffer, which avoids reallocation copies of large saved data. The
+         * segments are compressed once and resent as separate commands.
+         */
+        void enableSegmentedSave();
+
         /** @internal @return if data was sent since the last enable() */
         CO_API bool hasSentData() const;
 
@@ -77,7 +86,13 @@ namespace DataStreamTest { class Sender; }
         template< class T > DataOStream& operator << ( const T& value )
             { _write( &value, sizeof( value )); return *this; }
 
-        /** Write a C array. @version 1.0 */
+        /**
+         * Write a C array.
+         *
+         * Arrays bigger than the object buffer size are sent directly from
+         * the given memory, unless the stream saves its data.
+         * @version 1.0
+         */
         template< class T > DataOStream& operator << ( Array< T > array )
             { _write( array.data, array.getNumBytes( )); return *this; }
 
@@ -123,7 +138,15 @@ namespace DataStreamTest { class Sender; }
         CO_API lunchbox::Bufferb& getBuffer();
 
         /** @internal Initialize the given compressor. */
-        void _initCompressor( const uint32_t compressor );
+        CO_API void _initCompressor( const uint32_t compressor );
+
+        /**
+         * @internal Share the compression decision with other streams.
+         *
+         * Uncompressible data skips compression for a number of subsequent
+         * enabled streams, i.e., commits, counted in the given variable.
+         */
+        void _setCompressionSkips( lunchbox::a_int32_t& skips );
 
         /** @internal Enable output. */
         CO_API void _enable();
@@ -172,8 +195,24 @@ namespace DataStreamTest { class Sender; }
         /** Write a number of bytes from data into the stream. */
         CO_API void _write( const void* data, uint64_t size );
 
+        /** Write a large data item without copying it into the buffer. */
+        void _writeReference( const void* data, const uint64_t size );
+
+        /** Copy a large data item into its own segment and send it. */
+        void _writeSegment( const void* data, const uint64_t size );
+
+        /** Move the buffered data into a new segment and send it. */
+        void _flushSegment( const bool last );
+
+        /** Send the saved segment with the given index. */
+        void _sendSegment( const size_t index, const bool last );
+
+        /** disable() for segmented saving. */
+        void _disableSegmented();
+
         /** Helper function preparing data for sendData() as needed. */
-        void _sendData( const void* data, const uint64_t size );
+        void _sendData( const void* data, const uint64_t size,
+                        const bool last );
 
         /** Reset after sending a buffer. */
         void _resetBuffer();
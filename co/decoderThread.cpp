@@ -0,0 +1,59 @@
+
+/* Copyright (c) 2012, Stefan Eilemann <eile@eyescale.ch>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "decoderThread.h"
+
+#include "objectDataIStream.h"
+
+namespace co
+{
+DecoderThread::~DecoderThread()
+{
+    stop();
+}
+
+void DecoderThread::decode( ObjectDataIStream* stream )
+{
+    LBASSERT( stream->isReady( ));
+    if( !isRunning( ))
+        LBCHECK( start( ));
+
+    stream->setDecoding();
+    _queue.push( stream );
+}
+
+void DecoderThread::stop()
+{
+    if( !isRunning( ))
+        return;
+
+    _queue.push( 0 );
+    LBCHECK( join( ));
+}
+
+bool DecoderThread::init()
+{
+    setName( "Decoder" );
+    return true;
+}
+
+void DecoderThread::run()
+{
+    while( ObjectDataIStream* stream = _queue.pop( ))
+        stream->decode();
+}
+}
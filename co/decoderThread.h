@@ -0,0 +1,56 @@
+
+/* Copyright (c) 2012, Stefan Eilemann <eile@eyescale.ch>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CO_DECODERTHREAD_H
+#define CO_DECODERTHREAD_H
+
+#include <co/types.h>
+
+#include <lunchbox/mtQueue.h> // member
+#include <lunchbox/thread.h>  // base class
+
+namespace co
+{
+    /**
+     * @internal
+     * Decompresses ready object data streams ahead of their consumption.
+     *
+     * Queued streams are decoded in order. Readers of a queued stream block
+     * until its decoding has finished.
+     */
+    class DecoderThread : public lunchbox::Thread
+    {
+    public:
+        DecoderThread() {}
+        virtual ~DecoderThread();
+
+        /** Queue a ready stream for decoding. */
+        void decode( ObjectDataIStream* stream );
+
+        /** Decode all queued streams and stop the thread. */
+        void stop();
+
+    protected:
+        virtual bool init();
+        virtual void run();
+
+    private:
+        lunchbox::MTQueue< ObjectDataIStream* > _queue;
+    };
+}
+
+#endif // CO_DECODERTHREAD_H
@@ -19,6 +19,8 @@
 #include "dispatcher.h"
 
 #include "commandQueue.h"
+#include "commandStats.h"
+#include "commandTrace.h"
 #include "iCommand.h"
 #include "node.h"
 
@@ -36,6 +38,9 @@ public:
 
     /** Defines a queue to which commands are dispatched from the recv. */
     std::vector< co::CommandQueue* > qTable;
+
+    /** Commands which may be dispatched locally, bypassing the connection. */
+    std::vector< bool > unordered;
 };
 }
 
@@ -89,6 +94,8 @@ bool Dispatcher::dispatchCommand( ICommand& command )
            << std::endl;
 
     const uint32_t which = command.getCommand();
+    if( command.isTraced( ))
+        command.setDispatchTime( CommandStats::getTime( ));
 #ifndef NDEBUG
     if( which >= _impl->qTable.size( ))
     {
@@ -109,10 +116,41 @@ bool Dispatcher::dispatchCommand( ICommand& command )
     }
     // else
 
+    const bool stats = CommandStats::isEnabled();
+    if( !stats && !command.isTraced( ))
+    {
+        LBCHECK( _impl->fTable[ which ]( command ));
+        return true;
+    }
+
+    // handlers may change the command
+    const uint32_t type = command.getType();
+    const uint64_t size = command.getSize_();
+    const int64_t start = CommandStats::getTime();
     LBCHECK( _impl->fTable[ which ]( command ));
+    const int64_t done = CommandStats::getTime();
+
+    if( stats )
+        CommandStats::record( type, which, size, -1, done - start );
+    if( command.isTraced( ))
+        CommandTrace::record( command, type, which, -1, done );
     return true;
 }
 
+void Dispatcher::setUnordered( const uint32_t command )
+{
+    LBASSERT( command < _impl->qTable.size() && _impl->qTable[ command ] );
+    if( _impl->unordered.size() <= command )
+        _impl->unordered.resize( command + 1, false );
+    _impl->unordered[ command ] = true;
+}
+
+bool Dispatcher::isUnordered( const uint32_t command ) const
+{
+    return command < _impl->unordered.size() && _impl->unordered[ command ] &&
+           _impl->qTable[ command ];
+}
+
 bool Dispatcher::_cmdUnknown( ICommand& command )
 {
     LBERROR << "Unknown " << command << " for " << lunchbox::className( this )
@@ -55,6 +55,14 @@ namespace detail { class Dispatcher; }
          */
         CO_API virtual bool dispatchCommand( ICommand& command );
 
+        /**
+         * @internal
+         * @return true if the command is dispatched to a command queue and may
+         *         overtake other commands, false otherwise.
+         * @sa setUnordered
+         */
+        CO_API bool isUnordered( const uint32_t command ) const;
+
     protected:
         /**
          * Registers a command member function for a command.
@@ -73,6 +81,17 @@ namespace detail { class Dispatcher; }
                          CommandQueue* destinationQueue );
 
 
+        /**
+         * @internal
+         * Allow local sends of a queued command to bypass the connection.
+         *
+         * The command may then overtake commands still in transit. Only use it
+         * for commands whose handling does not depend on their order.
+         *
+         * @param command the command.
+         */
+        CO_API void setUnordered( const uint32_t command );
+
         /**
          * The default handler for handling commands.
          *
@@ -14,12 +14,14 @@ set(CO_PUBLIC_HEADERS
   iCommand.h
   commandFunc.h
   commandQueue.h
+  commandStats.h
   commands.h
   compressor.h
   compressorInfo.h
   connection.h
   connectionDescription.h
   connectionSet.h
+  connectionStats.h
   connectionType.h
   cpuCompressor.h
   customICommand.h
@@ -67,12 +69,15 @@ set(CO_PUBLIC_HEADERS
 set(CO_HEADERS
   barrierCommand.h
   bufferCache.h
+  commandTrace.h
   connectionListener.h
   dataStreamArchive.h
   dataIStreamQueue.h
+  decoderThread.h
   deltaMasterCM.h
   eventConnection.h
   fullMasterCM.h
+  instanceCacheFile.h
   masterCMCommand.h
   nodeCommand.h
   nullCM.h
@@ -87,6 +92,7 @@ set(CO_HEADERS
   objectStore.h
   pipeConnection.h
   rspConnection.h
+  sendTokenScheduler.h
   socketConnection.h
   staticMasterCM.h
   staticSlaveCM.h
@@ -102,6 +108,8 @@ set(CO_SOURCES
   bufferConnection.cpp
   iCommand.cpp
   commandQueue.cpp
+  commandStats.cpp
+  commandTrace.cpp
   compressor.cpp
   connection.cpp
   connectionDescription.cpp
@@ -112,6 +120,7 @@ set(CO_SOURCES
   dataIStream.cpp
   dataIStreamQueue.cpp
   dataOStream.cpp
+  decoderThread.cpp
   deltaMasterCM.cpp
   dispatcher.cpp
   eventConnection.cpp
@@ -119,6 +128,7 @@ set(CO_SOURCES
   global.cpp
   init.cpp
   instanceCache.cpp
+  instanceCacheFile.cpp
   localNode.cpp
   masterCMCommand.cpp
   node.cpp
@@ -143,6 +153,7 @@ set(CO_SOURCES
   queueItem.cpp
   queueMaster.cpp
   queueSlave.cpp
+  sendTokenScheduler.cpp
   serializable.cpp
   socketConnection.cpp
   staticSlaveCM.cpp
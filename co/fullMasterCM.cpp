@@ -296,7 +296,7 @@ FullMasterCM::InstanceData* FullMasterCM::_newInstanceData()
 
     instanceData->commitCount = _commitCount;
     instanceData->os.reset();
-    instanceData->os.enableSave();
+    instanceData->os.enableSegmentedSave();
     return instanceData;
 }
 
@@ -94,7 +94,18 @@ int32_t     _iAttributes[Global::IATTR_ALL] =
     5000,   // RDMA_RESOLVE_TIMEOUT_MS
     1,      // IATTR_ROBUSTNESS
     _getTimeout(), // IATTR_TIMEOUT_DEFAULT
-    1023    // IATTR_OBJECT_COMPRESSION
+    1023,   // IATTR_OBJECT_COMPRESSION
+    0,      // IATTR_OBJECT_PREFETCH
+    0,      // IATTR_OBJECT_STREAMING
+    1024,   // IATTR_INSTANCE_CACHE_FILE_SIZE
+    0,      // IATTR_QUEUE_ADAPTIVE
+    0,      // IATTR_BARRIER_FANOUT
+    0,      // IATTR_BARRIER_MULTICAST
+    0,      // IATTR_NODE_SEND_TOKENS
+    131072, // IATTR_NODE_SEND_TOKEN_BANDWIDTH
+    2,      // IATTR_OBJECT_COMMAND_THREADS
+    1,      // IATTR_COMMAND_STATS
+    0       // IATTR_COMMAND_TRACE
 };
 }
 
@@ -119,6 +119,17 @@ namespace co
             IATTR_ROBUSTNESS,            //!< @internal use robustness
             IATTR_TIMEOUT_DEFAULT,       //!< @internal default timeout
             IATTR_OBJECT_COMPRESSION,    //!< @internal threshold to compress
+            IATTR_OBJECT_PREFETCH,       //!< @internal decode slave data early
+            IATTR_OBJECT_STREAMING,      //!< @internal unpack partial versions
+            IATTR_INSTANCE_CACHE_FILE_SIZE, //!< @internal max file size in MB
+            IATTR_QUEUE_ADAPTIVE,        //!< @internal adapt queue prefetching
+            IATTR_BARRIER_FANOUT,        //!< @internal barrier release tree
+            IATTR_BARRIER_MULTICAST,     //!< @internal barrier release multicast
+            IATTR_NODE_SEND_TOKENS,      //!< @internal concurrent send tokens
+            IATTR_NODE_SEND_TOKEN_BANDWIDTH, //!< @internal KB/s per send token
+            IATTR_OBJECT_COMMAND_THREADS, //!< @internal object command lanes
+            IATTR_COMMAND_STATS,         //!< @internal record dispatch stats
+            IATTR_COMMAND_TRACE,         //!< @internal traced commands kept
             IATTR_ALL
         };
 
@@ -19,6 +19,8 @@
 #include "iCommand.h"
 
 #include "buffer.h"
+#include "commandStats.h"
+#include "commandTrace.h"
 #include "localNode.h"
 #include "node.h"
 #include "node.h"
@@ -37,10 +39,17 @@ public:
         , size( 0 )
         , type( COMMANDTYPE_INVALID )
         , cmd( CMD_INVALID )
+        , queueTime( -1 )
+        , sendTime( -1 )
+        , receiveTime( -1 )
+        , dispatchTime( -1 )
+        , offset( 0 )
+        , sliceSize( 0 )
         , consumed( false )
     {}
 
-    ICommand( LocalNodePtr local_, NodePtr remote_, ConstBufferPtr buffer_ )
+    ICommand( LocalNodePtr local_, NodePtr remote_, ConstBufferPtr buffer_,
+              const uint64_t offset_, const uint64_t sliceSize_ )
         : local( local_ )
         , remote( remote_ )
         , func( 0, 0 )
@@ -48,6 +57,12 @@ public:
         , size( 0 )
         , type( COMMANDTYPE_INVALID )
         , cmd( CMD_INVALID )
+        , queueTime( -1 )
+        , sendTime( -1 )
+        , receiveTime( -1 )
+        , dispatchTime( -1 )
+        , offset( offset_ )
+        , sliceSize( sliceSize_ )
         , consumed( false )
     {}
 
@@ -63,6 +78,12 @@ public:
     uint64_t size;
     uint32_t type;
     uint32_t cmd;
+    int64_t queueTime; //!< CommandQueue push time for statistics
+    int64_t sendTime; //!< sender clock, -1 if not traced
+    int64_t receiveTime;
+    int64_t dispatchTime;
+    uint64_t offset; //!< start of the command data in buffer
+    uint64_t sliceSize; //!< size of the command data, 0 for the whole buffer
     bool consumed;
 };
 }
@@ -76,10 +97,35 @@ ICommand::ICommand()
 ICommand::ICommand( LocalNodePtr local, NodePtr remote, ConstBufferPtr buffer,
                   const bool swap_ )
     : DataIStream( swap_ )
-    , _impl( new detail::ICommand( local, remote, buffer ))
+    , _impl( new detail::ICommand( local, remote, buffer, 0, 0 ))
 {
-    if( _impl->buffer )
-        *this >> _impl->size >> _impl->type >> _impl->cmd;
+    _readHeader();
+}
+
+ICommand::ICommand( LocalNodePtr local, NodePtr remote, ConstBufferPtr buffer,
+                    const uint64_t offset, const uint64_t size,
+                    const bool swap_ )
+    : DataIStream( swap_ )
+    , _impl( new detail::ICommand( local, remote, buffer, offset, size ))
+{
+    LBASSERT( size > 0 );
+    LBASSERT( !buffer || offset + size <= buffer->getSize( ));
+    _readHeader();
+}
+
+void ICommand::_readHeader()
+{
+    if( !_impl->buffer )
+        return;
+
+    *this >> _impl->size >> _impl->type >> _impl->cmd;
+    if( _impl->type != COMMANDTYPE_INVALID &&
+        ( _impl->type & CommandTrace::COMMANDTYPE_TRACED ))
+    {
+        _impl->type &= ~CommandTrace::COMMANDTYPE_TRACED;
+        *this >> _impl->sendTime;
+        _impl->receiveTime = CommandStats::getTime();
+    }
 }
 
 ICommand::ICommand( const ICommand& rhs )
@@ -114,8 +160,10 @@ void ICommand::clear()
 
 void ICommand::_skipHeader()
 {
-    const size_t headerSize = sizeof( _impl->size ) + sizeof( _impl->type ) +
-                              sizeof( _impl->cmd );
+    size_t headerSize = sizeof( _impl->size ) + sizeof( _impl->type ) +
+                        sizeof( _impl->cmd );
+    if( isTraced( ))
+        headerSize += sizeof( _impl->sendTime );
     if( isValid() && getRemainingBufferSize() >= headerSize )
         getRemainingBuffer( headerSize );
 }
@@ -182,8 +230,9 @@ bool ICommand::getNextBuffer( uint32_t& compressor, uint32_t& nChunks,
     _impl->consumed = true;
 #endif
 
-    *chunkData = _impl->buffer->getData();
-    size = _impl->buffer->getSize();
+    *chunkData = _impl->buffer->getData() + _impl->offset;
+    size = _impl->sliceSize ? _impl->sliceSize :
+                              _impl->buffer->getSize() - _impl->offset;
     compressor = EQ_COMPRESSOR_NONE;
     nChunks = 1;
     return true;
@@ -206,12 +255,60 @@ bool ICommand::isValid() const
            _impl->size > 0;
 }
 
+void ICommand::setQueueTime( const int64_t time )
+{
+    _impl->queueTime = time;
+}
+
+bool ICommand::isTraced() const
+{
+    return _impl->sendTime >= 0;
+}
+
+int64_t ICommand::getSendTime() const
+{
+    return _impl->sendTime;
+}
+
+int64_t ICommand::getReceiveTime() const
+{
+    return _impl->receiveTime;
+}
+
+int64_t ICommand::getDispatchTime() const
+{
+    return _impl->dispatchTime;
+}
+
+void ICommand::setDispatchTime( const int64_t time )
+{
+    if( _impl->dispatchTime < 0 ) // keep first dispatch of redispatched cmds
+        _impl->dispatchTime = time;
+}
+
 bool ICommand::operator()()
 {
     LBASSERT( _impl->func.isValid( ));
     Dispatcher::Func func = _impl->func;
     _impl->func.clear();
-    return func( *this );
+    const bool stats = CommandStats::isEnabled();
+    if( !stats && !isTraced( ))
+        return func( *this );
+
+    // handlers may change the command
+    const uint32_t type = _impl->type;
+    const uint32_t cmd = _impl->cmd;
+    const int64_t start = CommandStats::getTime();
+    const int64_t queueTime = _impl->queueTime < 0 ? -1 :
+                                  start - _impl->queueTime;
+
+    const bool result = func( *this );
+    const int64_t done = CommandStats::getTime();
+    if( stats )
+        CommandStats::record( type, cmd, _impl->size, queueTime, done - start);
+    if( isTraced( ))
+        CommandTrace::record( *this, type, cmd, start, done );
+    return result;
 }
 
 std::ostream& operator << ( std::ostream& os, const ICommand& command )
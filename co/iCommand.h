@@ -44,6 +44,11 @@ namespace detail { class ICommand; }
         CO_API ICommand(); //!< @internal
         CO_API ICommand( LocalNodePtr local, NodePtr remote,
                         ConstBufferPtr buffer, const bool swap ); //!< @internal
+
+        /** @internal Construct a command from a part of a shared buffer. */
+        CO_API ICommand( LocalNodePtr local, NodePtr remote,
+                         ConstBufferPtr buffer, const uint64_t offset,
+                         const uint64_t size, const bool swap );
         CO_API ICommand( const ICommand& rhs ); //!< @internal
 
         CO_API ICommand& operator = ( const ICommand& rhs ); //!< @internal
@@ -95,6 +100,24 @@ namespace detail { class ICommand; }
         /** Set the function to which the command is dispatched. */
         void setDispatchFunction( const Dispatcher::Func& func );
 
+        /** Set the time the command was queued, for CommandStats. */
+        void setQueueTime( const int64_t time );
+
+        /** @return true if the command carries a CommandTrace send time. */
+        bool isTraced() const;
+
+        /** @return the send time in the clock of the sender, or -1. */
+        int64_t getSendTime() const;
+
+        /** @return the receive time, or -1 if not traced. */
+        int64_t getReceiveTime() const;
+
+        /** @return the first dispatch time, or -1 if not traced. */
+        int64_t getDispatchTime() const;
+
+        /** Set the dispatch time, unless set already. */
+        void setDispatchTime( const int64_t time );
+
         /** Invoke and clear the command function of a dispatched command. */
         CO_API bool operator()();
         //@}
@@ -115,6 +138,7 @@ namespace detail { class ICommand; }
                                            uint64_t& size );
         //@}
 
+        void _readHeader(); //!< @internal
         void _skipHeader(); //!< @internal
     };
 
@@ -27,39 +27,31 @@
 
 namespace co
 {
-//#define EQ_INSTRUMENT_CACHE
-#ifdef EQ_INSTRUMENT_CACHE
-namespace
-{
-lunchbox::a_int32_t nRead;
-lunchbox::a_int32_t nReadHit;
-lunchbox::a_int32_t nWrite;
-lunchbox::a_int32_t nWriteHit;
-lunchbox::a_int32_t nWriteMiss;
-lunchbox::a_int32_t nWriteReady;
-lunchbox::a_int32_t nWriteOld;
-lunchbox::a_int32_t nUsedRelease;
-lunchbox::a_int32_t nUnusedRelease;
-}
-#endif
-
 const InstanceCache::Data InstanceCache::Data::NONE;
 
 InstanceCache::InstanceCache( const uint64_t maxSize )
         : _maxSize( maxSize )
         , _size( 0 )
+        , _nextShard( 0 )
 {}
 
 InstanceCache::~InstanceCache()
 {
-    for( ItemHash::iterator i = _items->begin(); i != _items->end(); ++i )
+    for( size_t i = 0; i < N_SHARDS; ++i )
     {
-        Item& item = i->second;
-        _releaseStreams( item );
-    }
+        Shard& shard = _shards[ i ];
+        for( ItemHashIter j = shard.items.begin(); j != shard.items.end(); ++j )
+        {
+            Item& item = j->second;
+            _releaseStreams( shard, item );
+        }
 
-    _items->clear();
-    _size = 0;
+        shard.items.clear();
+        shard.unused.clear();
+        shard.used.clear();
+        LBASSERTINFO( shard.size == 0, shard.size );
+    }
+    LBASSERTINFO( _size == 0, _size );
 }
 
 InstanceCache::Data::Data()
@@ -81,36 +73,81 @@ bool InstanceCache::Data::operator == ( const InstanceCache::Data& rhs ) const
 InstanceCache::Item::Item()
         : used( 0 )
         , access( 0 )
+        , lru( 0 )
 {}
 
+InstanceCache::Shard& InstanceCache::_getShard( const lunchbox::uint128_t& id )
+{
+    const uint64_t hash = id.high() ^ id.low();
+    return _shards[ ( hash ^ ( hash >> 16 ) ^ ( hash >> 32 )) % N_SHARDS ];
+}
+
+InstanceCache::Item& InstanceCache::_getItem( Shard& shard,
+                                              const lunchbox::uint128_t& id )
+{
+    ItemHashIter i = shard.items.find( id );
+    if( i != shard.items.end( ))
+        return i->second;
+
+    Item& item = shard.items[ id ];
+    item.lru = &shard.unused;
+    item.position = shard.unused.insert( shard.unused.end(), id );
+    return item;
+}
+
+void InstanceCache::_eraseItem( Shard& shard, ItemHashIter i )
+{
+    Item& item = i->second;
+    item.lru->erase( item.position );
+    shard.items.erase( i );
+}
+
+void InstanceCache::_touch( Shard& shard, Item& item )
+{
+    // move to the most recently used end of the list matching the usage
+    LRUList& lru = item.used > 0 ? shard.used : shard.unused;
+    lru.splice( lru.end(), *item.lru, item.position );
+    item.lru = &lru;
+}
+
 bool InstanceCache::add( const ObjectVersion& rev, const uint32_t instanceID,
                          ICommand& command, const uint32_t usage )
 {
-    LBASSERTINFO( command.isValid(), command );
+    if( !_add( rev, instanceID, command, usage ))
+        return false;
 
-#ifdef EQ_INSTRUMENT_CACHE
-    ++nWrite;
-#endif
+    // outside of the shard lock, eviction may lock any shard
+    _releaseItems( true );
+    return true;
+}
+
+bool InstanceCache::_add( const ObjectVersion& rev, const uint32_t instanceID,
+                          ICommand& command, const uint32_t usage )
+{
+    LBASSERTINFO( command.isValid(), command );
 
     const NodeID nodeID = command.getNode()->getNodeID();
 
-    lunchbox::ScopedMutex<> mutex( _items );
-    ItemHash::const_iterator i = _items->find( rev.identifier );
-    if( i == _items->end( ))
+    Shard& shard = _getShard( rev.identifier );
+    lunchbox::ScopedMutex<> mutex( shard.lock );
+    ++shard.writes;
+
+    ItemHash::const_iterator i = shard.items.find( rev.identifier );
+    if( i == shard.items.end( ))
     {
-        Item& item = _items.data[ rev.identifier ];
+        Item& item = _getItem( shard, rev.identifier );
         item.data.masterInstanceID = instanceID;
         item.from = nodeID;
     }
 
-    Item& item = _items.data[ rev.identifier ] ;
+    Item& item = _getItem( shard, rev.identifier );
     if( item.data.masterInstanceID != instanceID || item.from != nodeID )
     {
         LBASSERT( !item.access ); // same master with different instance ID?!
         if( item.access != 0 ) // are accessed - don't add
             return false;
         // trash data from different master mapping
-        _releaseStreams( item );
+        _releaseStreams( shard, item );
         item.data.masterInstanceID = instanceID;
         item.from = nodeID;
         item.used = usage;
@@ -126,12 +163,7 @@ bool InstanceCache::add( const ObjectVersion& rev, const uint32_t instanceID,
     else if( item.data.versions.back()->getPendingVersion() == rev.version )
     {
         if( item.data.versions.back()->isReady( ))
-        {
-#ifdef EQ_INSTRUMENT_CACHE
-            ++nWriteReady;
-#endif
             return false; // Already have stream
-        }
         // else append data to stream
     }
     else
@@ -141,12 +173,8 @@ bool InstanceCache::add( const ObjectVersion& rev, const uint32_t instanceID,
 
         const uint128_t previousVersion = previous->getPendingVersion();
         if( previousVersion > rev.version )
-        {
-#ifdef EQ_INSTRUMENT_CACHE
-            ++nWriteOld;
-#endif
             return false;
-        }
+
         if( ( previousVersion + 1 ) != rev.version ) // hole
         {
             LBASSERT( previousVersion < rev.version );
@@ -154,7 +182,7 @@ bool InstanceCache::add( const ObjectVersion& rev, const uint32_t instanceID,
             if( item.access != 0 ) // are accessed - don't add
                 return false;
 
-            _releaseStreams( item );
+            _releaseStreams( shard, item );
         }
         else
         {
@@ -170,97 +198,101 @@ bool InstanceCache::add( const ObjectVersion& rev, const uint32_t instanceID,
     stream->addDataCommand( command );
 
     if( stream->isReady( ))
-        _size += stream->getDataSize();
-
-    _releaseItems( 1 );
-    _releaseItems( 0 );
+    {
+        const uint64_t size = stream->getDataSize();
+        shard.size += size;
+        _size += size;
+    }
 
-#ifdef EQ_INSTRUMENT_CACHE
-    if( _items->find( rev.identifier ) != _items->end( ))
-        ++nWriteHit;
-    else
-        ++nWriteMiss;
-#endif
+    _touch( shard, item );
     return true;
 }
 
 void InstanceCache::remove( const NodeID& nodeID )
 {
-    std::vector< lunchbox::uint128_t > keys;
-
-    lunchbox::ScopedMutex<> mutex( _items );
-    for( ItemHash::iterator i = _items->begin(); i != _items->end(); ++i )
+    for( size_t i = 0; i < N_SHARDS; ++i )
     {
-        Item& item = i->second;
-        if( item.from != nodeID )
-            continue;
+        Shard& shard = _shards[ i ];
+        lunchbox::ScopedMutex<> mutex( shard.lock );
 
-        LBASSERT( !item.access );
-        if( item.access != 0 )
-            continue;
+        for( ItemHashIter j = shard.items.begin(); j != shard.items.end(); )
+        {
+            Item& item = j->second;
+            if( item.from != nodeID )
+            {
+                ++j;
+                continue;
+            }
 
-        _releaseStreams( item );
-        keys.push_back( i->first );
-    }
+            LBASSERT( !item.access );
+            if( item.access != 0 )
+            {
+                ++j;
+                continue;
+            }
 
-    for( std::vector< lunchbox::uint128_t >::const_iterator i = keys.begin();
-         i != keys.end(); ++i )
-    {
-        _items->erase( *i );
+            _releaseStreams( shard, item );
+            _eraseItem( shard, j++ );
+        }
     }
 }
 
 const InstanceCache::Data& InstanceCache::operator[]( const UUID& id )
 {
-#ifdef EQ_INSTRUMENT_CACHE
-    ++nRead;
-#endif
+    Shard& shard = _getShard( id );
+    lunchbox::ScopedMutex<> mutex( shard.lock );
+    ++shard.reads;
 
-    lunchbox::ScopedMutex<> mutex( _items );
-    ItemHash::iterator i = _items->find( id );
-    if( i == _items->end( ))
+    ItemHashIter i = shard.items.find( id );
+    if( i == shard.items.end( ))
         return Data::NONE;
 
     Item& item = i->second;
     LBASSERT( !item.data.versions.empty( ));
     ++item.access;
     ++item.used;
+    ++shard.hits;
 
-#ifdef EQ_INSTRUMENT_CACHE
-    ++nReadHit;
-#endif
+    _touch( shard, item );
     return item.data;
 }
 
 bool InstanceCache::release( const UUID& id, const uint32_t count )
 {
-    lunchbox::ScopedMutex<> mutex( _items );
-    ItemHash::iterator i = _items->find( id );
-    if( i == _items->end( ))
-        return false;
+    {
+        Shard& shard = _getShard( id );
+        lunchbox::ScopedMutex<> mutex( shard.lock );
 
-    Item& item = i->second;
-    LBASSERT( !item.data.versions.empty( ));
-    LBASSERT( item.access >= count );
+        ItemHashIter i = shard.items.find( id );
+        if( i == shard.items.end( ))
+            return false;
+
+        Item& item = i->second;
+        LBASSERT( !item.data.versions.empty( ));
+        LBASSERT( item.access >= count );
 
-    item.access -= count;
-    _releaseItems( 1 );
+        item.access -= count;
+    }
+
+    _releaseItems( false );
     return true;
 }
 
 bool InstanceCache::erase( const UUID& id )
 {
-    lunchbox::ScopedMutex<> mutex( _items );
-    ItemHash::iterator i = _items->find( id );
-    if( i == _items->end( ))
+    Shard& shard = _getShard( id );
+    lunchbox::ScopedMutex<> mutex( shard.lock );
+
+    ItemHashIter i = shard.items.find( id );
+    if( i == shard.items.end( ))
         return false;
 
     Item& item = i->second;
     if( item.access != 0 )
         return false;
 
-    _releaseStreams( item );
-    _items->erase( i );
+    _releaseStreams( shard, item );
+    _eraseItem( shard, i );
     return true;
 }
 
@@ -270,39 +302,77 @@ void InstanceCache::expire( const int64_t timeout )
     if( time <= 0 )
         return;
 
-    std::vector< lunchbox::uint128_t > keys;
-
-    lunchbox::ScopedMutex<> mutex( _items );
-    for( ItemHash::iterator i = _items->begin(); i != _items->end(); ++i )
+    for( size_t i = 0; i < N_SHARDS; ++i )
     {
-        Item& item = i->second;
-        if( item.access != 0 )
-            continue;
+        Shard& shard = _shards[ i ];
+        lunchbox::ScopedMutex<> mutex( shard.lock );
 
-        _releaseStreams( item, time );
-        if( item.data.versions.empty( ))
-            keys.push_back( i->first );
+        for( ItemHashIter j = shard.items.begin(); j != shard.items.end(); )
+        {
+            Item& item = j->second;
+            if( item.access != 0 )
+            {
+                ++j;
+                continue;
+            }
+
+            _releaseStreams( shard, item, time );
+            if( item.data.versions.empty( ))
+                _eraseItem( shard, j++ );
+            else
+                ++j;
+        }
     }
+}
+
+uint64_t InstanceCache::getSize() const
+{
+    return _size;
+}
+
+bool InstanceCache::isEmpty() const
+{
+    for( size_t i = 0; i < N_SHARDS; ++i )
+    {
+        const Shard& shard = _shards[ i ];
+        lunchbox::ScopedMutex<> mutex( shard.lock );
+        if( !shard.items.empty( ))
+            return false;
+    }
+    return true;
+}
+
+InstanceCacheStats InstanceCache::getStats() const
+{
+    InstanceCacheStats stats;
+    stats.maxSize = _maxSize;
 
-    for( std::vector< lunchbox::uint128_t >::const_iterator i = keys.begin();
-         i != keys.end(); ++i )
+    for( size_t i = 0; i < N_SHARDS; ++i )
     {
-        _items->erase( *i );
+        const Shard& shard = _shards[ i ];
+        lunchbox::ScopedMutex<> mutex( shard.lock );
+        stats.reads += shard.reads;
+        stats.hits += shard.hits;
+        stats.writes += shard.writes;
+        stats.evictions += shard.evictions;
+        stats.size += shard.size;
+        stats.items += shard.items.size();
     }
+    return stats;
 }
 
-void InstanceCache::_releaseStreams( InstanceCache::Item& item,
+void InstanceCache::_releaseStreams( Shard& shard, InstanceCache::Item& item,
                                      const int64_t minTime )
 {
     LBASSERT( item.access == 0 );
     while( !item.data.versions.empty() && item.times.front() <= minTime &&
            item.data.versions.front()->isReady( ))
     {
-        _releaseFirstStream( item );
+        _releaseFirstStream( shard, item );
     }
 }
 
-void InstanceCache::_releaseStreams( InstanceCache::Item& item )
+void InstanceCache::_releaseStreams( Shard& shard, InstanceCache::Item& item )
 {
     LBASSERT( item.access == 0 );
     LBASSERT( !item.data.versions.empty( ));
@@ -311,12 +381,13 @@ void InstanceCache::_releaseStreams( InstanceCache::Item& item )
     {
         ObjectDataIStream* stream = item.data.versions.back();
         item.data.versions.pop_back();
-        _deleteStream( stream );
+        _deleteStream( shard, stream );
     }
     item.times.clear();
 }
 
-void InstanceCache::_releaseFirstStream( InstanceCache::Item& item )
+void InstanceCache::_releaseFirstStream( Shard& shard,
+                                         InstanceCache::Item& item )
 {
     LBASSERT( item.access == 0 );
     LBASSERT( !item.data.versions.empty( ));
@@ -326,102 +397,90 @@ void InstanceCache::_releaseFirstStream( InstanceCache::Item& item )
     ObjectDataIStream* stream = item.data.versions.front();
     item.data.versions.pop_front();
     item.times.pop_front();
-    _deleteStream( stream );
+    _deleteStream( shard, stream );
 }
 
-void InstanceCache::_deleteStream( ObjectDataIStream* stream )
+void InstanceCache::_deleteStream( Shard& shard, ObjectDataIStream* stream )
 {
     LBASSERT( stream->isReady( ));
-    LBASSERT( _size >= stream->getDataSize( ));
+    LBASSERT( shard.size >= stream->getDataSize( ));
 
-    _size -= stream->getDataSize();
+    const uint64_t size = stream->getDataSize();
+    shard.size -= size;
+    _size -= size;
     delete stream;
 }
 
-void InstanceCache::_releaseItems( const uint32_t minUsage )
+void InstanceCache::_releaseItems( const bool releaseUnused )
 {
-    if( _size <= _maxSize )
-        return;
-
-    LB_TS_SCOPED( _thread );
-
-    std::vector< lunchbox::uint128_t > keys;
-    const uint64_t target = uint64_t( float( _maxSize ) * 0.8f );
-
-    // Release used items (first stream)
-    bool streamsLeft = false;
-    for( ItemHashIter i = _items->begin();
-         i != _items->end() && _size > target; ++i )
+    // Accessed items are released first, they are less likely to be mapped
+    // again than items which have never been used. The shards are visited
+    // round-robin, releasing one stream each, until the cache fits the budget
+    // or no shard has anything left to release.
+    const size_t nPasses = releaseUnused ? 2 : 1;
+    for( size_t pass = 0; pass < nPasses; ++pass )
     {
-        Item& item = i->second;
-        LBASSERT( !item.data.versions.empty( ));
-
-        if( item.access == 0 && item.used >= minUsage )
+        size_t nIdle = 0;
+        while( _size > _maxSize && nIdle < N_SHARDS )
         {
-            _releaseFirstStream( item );
-            if( !item.data.versions.empty( ))
-                streamsLeft = true;
-
-            keys.push_back( i->first );
-#ifdef EQ_INSTRUMENT_CACHE
-            ++nUsedRelease;
-#endif
+            const uint32_t index = uint32_t( ++_nextShard ) % N_SHARDS;
+            Shard& shard = _shards[ index ];
+            lunchbox::ScopedMutex<> mutex( shard.lock );
+
+            if( _releaseLRU( shard, pass == 0 ? shard.used : shard.unused ))
+                nIdle = 0;
+            else
+                ++nIdle;
         }
     }
 
-    // release used items (second..n streams)
-    while( streamsLeft && _size > target )
+    if( _size > _maxSize && releaseUnused )
+        LBWARN << "Overfull instance cache, too many pinned items, size "
+               << _size << " max " << _maxSize << std::endl;
+}
+
+bool InstanceCache::_releaseLRU( Shard& shard, LRUList& lru )
+{
+    // Pinned items are skipped, which are rare compared to the cached ones
+    for( LRUListIter i = lru.begin(); i != lru.end(); ++i )
     {
-        streamsLeft = false;
+        ItemHashIter j = shard.items.find( *i );
+        LBASSERT( j != shard.items.end( ));
 
-        for( std::vector< lunchbox::uint128_t >::const_iterator i = keys.begin();
-             i != keys.end() && _size > target; ++i )
+        Item& item = j->second;
+        if( item.access != 0 )
+            continue;
+
+        if( !item.data.versions.empty( ))
         {
-            Item& item = _items.data[ *i ];
+            if( !item.data.versions.front()->isReady( ))
+                continue; // still receiving data
 
-            if( !item.data.versions.empty() && item.access == 0 &&
-                item.used >= minUsage )
-            {
-                _releaseFirstStream( item );
-                if( !item.data.versions.empty( ))
-                    streamsLeft = true;
-#ifdef EQ_INSTRUMENT_CACHE
-                ++nUsedRelease;
-#endif
-            }
+            _releaseFirstStream( shard, item );
+            ++shard.evictions;
         }
-    }
 
-    for( std::vector< lunchbox::uint128_t >::const_iterator i = keys.begin();
-         i != keys.end(); ++i )
-    {
-        Item& item = _items.data[ *i ];
         if( item.data.versions.empty( ))
-            _items->erase( *i );
+            _eraseItem( shard, j );
+        return true;
     }
-
-    if( _size > target && minUsage == 0 )
-        LBWARN << "Overfull instance cache, too many pinned items, size "
-               << _size << " target " << target << " max " << _maxSize
-               << " " << _items->size() << " entries"
-#ifdef EQ_INSTRUMENT_CACHE
-               << ": " << *this
-#endif
-               << std::endl;
+    return false;
 }
 
 std::ostream& operator << ( std::ostream& os,
                             const InstanceCache& instanceCache )
 {
     os << "InstanceCache " << instanceCache.getSize() / 1048576 << "/"
-       << instanceCache.getMaxSize() / 1048576 << " MB"
-#ifdef EQ_INSTRUMENT_CACHE
-       << ", " << nReadHit << "/" << nRead << " reads, " << nWriteHit
-       << "/" << nWrite << " writes (" << nWriteMiss << " misses, " << nWriteOld
-       << " old, " << nWriteReady << " dups) " << nUsedRelease << " used, "
-       << nUnusedRelease << " unused releases"
-#endif
-        ;
+       << instanceCache.getMaxSize() / 1048576 << " MB, "
+       << instanceCache.getStats();
+    return os;
+}
+
+std::ostream& operator << ( std::ostream& os, const InstanceCacheStats& stats )
+{
+    os << stats.hits << "/" << stats.reads << " reads, " << stats.writes
+       << " writes, " << stats.evictions << " evictions, " << stats.items
+       << " items, " << stats.size << "/" << stats.maxSize << " bytes";
     return os;
 }
 
@@ -22,18 +22,45 @@
 #include <co/api.h>
 #include <co/types.h>
 
+#include <lunchbox/atomic.h>    // member
 #include <lunchbox/clock.h>     // member
 #include <lunchbox/lock.h>      // member
-#include <lunchbox/lockable.h>  // member
 #include <lunchbox/stdExt.h>    // member
-#include <lunchbox/thread.h>    // member
 #include <lunchbox/uuid.h>      // member
 
 #include <iostream>
+#include <list>
 
 namespace co
 {
-    /** @internal A thread-safe cache for object instance data. */
+    /** Statistics of an InstanceCache. */
+    struct InstanceCacheStats
+    {
+        InstanceCacheStats() : reads( 0 ), hits( 0 ), writes( 0 )
+                             , evictions( 0 ), size( 0 ), maxSize( 0 )
+                             , items( 0 ) {}
+
+        uint64_t reads;     //!< Number of lookups
+        uint64_t hits;      //!< Number of lookups finding cached data
+        uint64_t writes;    //!< Number of commands added to the cache
+        uint64_t evictions; //!< Number of streams released to fit the budget
+        uint64_t size;      //!< Number of bytes currently used
+        uint64_t maxSize;   //!< The budget in bytes, see getMaxSize()
+        uint64_t items;     //!< Number of cached objects
+
+        /** @return the number of lookups not finding cached data. */
+        uint64_t getMisses() const { return reads - hits; }
+    };
+
+    /**
+     * @internal A thread-safe cache for object instance data.
+     *
+     * The cache is split into shards by object identifier, each with its own
+     * lock and eviction order. All shards share one size budget. Eviction
+     * visits the shards round-robin and releases the oldest stream of the
+     * shard's least recently used object in constant time, preferring objects
+     * which have already been accessed.
+     */
     class InstanceCache
     {
     public:
@@ -105,17 +132,26 @@ namespace co
         CO_API bool erase( const UUID& id );
 
         /** @return the number of bytes used by the instance cache. */
-        uint64_t getSize() const { return _size; }
+        CO_API uint64_t getSize() const;
 
-        /** @return the maximum number of bytes used by the instance cache. */
+        /**
+         * @return the number of bytes above which the instance cache starts
+         *         releasing data.
+         */
         uint64_t getMaxSize() const { return _maxSize; }
 
+        /** @return the usage statistics of the instance cache. */
+        CO_API InstanceCacheStats getStats() const;
+
         /** Remove all items which are older than the given time. */
         void expire( const int64_t age );
 
-        bool isEmpty() { return _items->empty(); }
+        CO_API bool isEmpty() const;
 
     private:
+        typedef std::list< lunchbox::uint128_t > LRUList;
+        typedef LRUList::iterator LRUListIter;
+
         struct Item
         {
             Item();
@@ -126,28 +162,59 @@ namespace co
 
             typedef std::deque< int64_t > TimeDeque;
             TimeDeque times;
+
+            LRUList* lru;         //!< The eviction list holding this item
+            LRUListIter position; //!< The position in the eviction list
         };
 
         typedef stde::hash_map< lunchbox::uint128_t, Item > ItemHash;
         typedef ItemHash::iterator ItemHashIter;
-        lunchbox::Lockable< ItemHash > _items;
 
-        const uint64_t _maxSize; //!<high-water mark to start releasing commands
-        uint64_t _size;          //!< Current number of bytes stored
+        /** A part of the cache, protected by its own lock. */
+        struct Shard
+        {
+            Shard() : size( 0 ), reads( 0 ), hits( 0 ), writes( 0 )
+                    , evictions( 0 ) {}
+
+            mutable lunchbox::Lock lock;
+            ItemHash items;
+            LRUList unused; //!< Never accessed items, least recent first
+            LRUList used;   //!< Accessed items, least recent first
+            uint64_t size;  //!< Current number of bytes stored
+
+            uint64_t reads;
+            uint64_t hits;
+            uint64_t writes;
+            uint64_t evictions;
+        };
+
+        enum { N_SHARDS = 16 };
+        Shard _shards[ N_SHARDS ];
+
+        const uint64_t _maxSize; //!< high-water mark to start releasing data
+        lunchbox::Atomic< uint64_t > _size; //!< bytes stored in all shards
+        lunchbox::a_int32_t _nextShard; //!< round-robin eviction position
 
         const lunchbox::Clock _clock;  //!< Clock for item expiration
 
-        void _releaseItems( const uint32_t minUsage );
-        void _releaseStreams( InstanceCache::Item& item );
-        void _releaseStreams( InstanceCache::Item& item,
+        Shard& _getShard( const lunchbox::uint128_t& id );
+        Item& _getItem( Shard& shard, const lunchbox::uint128_t& id );
+        void _eraseItem( Shard& shard, ItemHashIter i );
+        void _touch( Shard& shard, Item& item );
+
+        bool _add( const ObjectVersion& rev, const uint32_t instanceID,
+                   ICommand& command, const uint32_t usage );
+        void _releaseItems( const bool releaseUnused );
+        bool _releaseLRU( Shard& shard, LRUList& lru );
+        void _releaseStreams( Shard& shard, InstanceCache::Item& item );
+        void _releaseStreams( Shard& shard, InstanceCache::Item& item,
                               const int64_t minTime );
-        void _releaseFirstStream( InstanceCache::Item& item );
-        void _deleteStream( ObjectDataIStream* iStream );
-
-        LB_TS_VAR( _thread );
+        void _releaseFirstStream( Shard& shard, InstanceCache::Item& item );
+        void _deleteStream( Shard& shard, ObjectDataIStream* iStream );
     };
 
     CO_API std::ostream& operator << ( std::ostream&, const InstanceCache& );
+    CO_API std::ostream& operator << ( std::ostream&,
+                                       const InstanceCacheStats& );
 }
 #endif //CO_INSTANCECACHE_H
-
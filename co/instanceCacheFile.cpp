@@ -0,0 +1,504 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "instanceCacheFile.h"
+
+#include "buffer.h"
+#include "bufferListener.h"
+#include "commands.h"
+#include "instanceCache.h"
+#include "log.h"
+#include "node.h"
+
+#include <lunchbox/debug.h>
+#include <lunchbox/mtQueue.h>
+#include <lunchbox/scopedMutex.h>
+#include <lunchbox/thread.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace co
+{
+namespace
+{
+// The file is a header followed by a log of records. Each record is a record
+// header followed by nCommands times [uint64_t size][command buffer]. All
+// entries are padded to eight bytes, so that headers can be accessed in place.
+// The data is stored in host byte order. A later record of the same object and
+// master replaces earlier ones, which are dropped when the file is compacted.
+static const uint64_t _magic = 0x436f496e73744361ull; // CoInstCa
+static const uint64_t _formatVersion = 1;
+
+struct FileHeader
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t end; //!< end of the last complete record
+    uint64_t reserved;
+};
+
+struct RecordHeader
+{
+    uint64_t magic;
+    uint64_t size;
+    uint64_t id[2];
+    uint64_t master[2];
+    uint64_t version[2];
+    uint32_t instanceID;
+    uint32_t nCommands;
+};
+
+inline uint64_t _pad( const uint64_t size ) { return (size + 7) & ~7ull; }
+
+/** Deletes buffers recreated from the file once they are released. */
+class BufferDeleter : public BufferListener
+{
+public:
+    virtual void notifyFree( Buffer* buffer ) { delete buffer; }
+};
+static BufferDeleter _bufferDeleter;
+}
+
+namespace detail
+{
+/** Copies complete versions into the file, off the receiver thread. */
+class InstanceCacheFileWriter : public lunchbox::Thread
+{
+public:
+    struct Version
+    {
+        ObjectVersion rev;
+        co::InstanceCacheFile::Pending pending;
+    };
+
+    explicit InstanceCacheFileWriter( co::InstanceCacheFile& file )
+        : _file( file ) {}
+    virtual ~InstanceCacheFileWriter() { stop(); }
+
+    void write( Version* version )
+    {
+        if( !isRunning( ))
+            LBCHECK( start( ));
+        _queue.push( version );
+    }
+
+    /** Write all queued versions and stop the thread. */
+    void stop()
+    {
+        if( !isRunning( ))
+            return;
+
+        _queue.push( 0 );
+        LBCHECK( join( ));
+    }
+
+protected:
+    virtual bool init()
+    {
+        setName( "CacheWriter" );
+        return true;
+    }
+
+    virtual void run()
+    {
+        while( Version* version = _queue.pop( ))
+        {
+            _file._writeVersion( version->rev, version->pending );
+            delete version;
+        }
+    }
+
+private:
+    co::InstanceCacheFile& _file;
+    lunchbox::MTQueue< Version* > _queue;
+};
+}
+
+InstanceCacheFile::InstanceCacheFile()
+    : _nRecords( 0 )
+    , _fd( -1 )
+    , _data( 0 )
+    , _size( 0 )
+    , _writer( new detail::InstanceCacheFileWriter( *this ))
+{}
+
+InstanceCacheFile::~InstanceCacheFile()
+{
+    close();
+    delete _writer;
+}
+
+bool InstanceCacheFile::open( const std::string& filename,
+                              const uint64_t maxSize )
+{
+    lunchbox::ScopedMutex<> mutex( _lock );
+    LBASSERT( !_data );
+    if( maxSize < sizeof( FileHeader ) + sizeof( RecordHeader ))
+        return false;
+
+#ifdef _WIN32
+    LBWARN << "Persistent instance cache not implemented on Windows"
+           << std::endl;
+    return false;
+#else
+    _fd = ::open( filename.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR );
+    if( _fd < 0 )
+    {
+        LBWARN << "Can't open instance cache file " << filename << ": "
+               << lunchbox::sysError << std::endl;
+        return false;
+    }
+
+    if( ::ftruncate( _fd, maxSize ) != 0 )
+    {
+        LBWARN << "Can't resize instance cache file " << filename << ": "
+               << lunchbox::sysError << std::endl;
+        ::close( _fd );
+        _fd = -1;
+        return false;
+    }
+
+    void* data = ::mmap( 0, maxSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         _fd, 0 );
+    if( data == MAP_FAILED )
+    {
+        LBWARN << "Can't map instance cache file " << filename << ": "
+               << lunchbox::sysError << std::endl;
+        ::close( _fd );
+        _fd = -1;
+        return false;
+    }
+
+    _data = static_cast< uint8_t* >( data );
+    _size = maxSize;
+
+    const FileHeader* header = reinterpret_cast< const FileHeader* >( _data );
+    if( header->magic != _magic || header->version != _formatVersion ||
+        header->end < sizeof( FileHeader ) || header->end > _size )
+    {
+        _reset();
+    }
+    else
+        _scan();
+
+    LBLOG( LOG_OBJECTS ) << "Opened instance cache file " << filename
+                         << " with " << _nRecords << " versions" << std::endl;
+    return true;
+#endif
+}
+
+void InstanceCacheFile::close()
+{
+    _writer->stop();
+    _pending.clear();
+
+    lunchbox::ScopedMutex<> mutex( _lock );
+#ifndef _WIN32
+    if( _data )
+        ::munmap( _data, _size );
+    if( _fd >= 0 )
+        ::close( _fd );
+#endif
+    _data = 0;
+    _fd = -1;
+    _size = 0;
+    _index.clear();
+    _nRecords = 0;
+}
+
+size_t InstanceCacheFile::getSize() const
+{
+    lunchbox::ScopedMutex<> mutex( _lock );
+    return _nRecords;
+}
+
+void InstanceCacheFile::add( const ObjectVersion& rev,
+                             const uint32_t instanceID,
+                             const ObjectDataICommand& command )
+{
+    if( !isOpen( ))
+        return;
+
+    // OPT: Called from the receiver thread, only keep a reference to the data
+    // and leave the copy to the writer thread
+    Pending& pending = _pending[ rev ];
+    pending.instanceID = instanceID;
+    pending.commands.push_back( command );
+
+    if( !command.isLast( ))
+        return;
+
+    detail::InstanceCacheFileWriter::Version* version =
+        new detail::InstanceCacheFileWriter::Version;
+    version->rev = rev;
+    version->pending.instanceID = instanceID;
+    version->pending.commands.swap( pending.commands );
+    _pending.erase( rev );
+    _writer->write( version );
+}
+
+void InstanceCacheFile::flush()
+{
+    _writer->stop();
+}
+
+size_t InstanceCacheFile::load( const UUID& id, NodePtr master,
+                                LocalNodePtr localNode, InstanceCache& cache )
+{
+    Record record;
+    std::vector< BufferPtr > buffers;
+    {
+        // The writer thread may move records, copy the data under the lock
+        lunchbox::ScopedMutex<> mutex( _lock );
+        RecordHashIter i = _index.find( id );
+        if( i == _index.end( ))
+            return 0;
+
+        const NodeID& masterID = master->getNodeID();
+        RecordsIter j = i->second.begin();
+        while( j != i->second.end() && j->master != masterID )
+            ++j;
+        if( j == i->second.end( ))
+            return 0;
+
+        record = *j;
+        const RecordHeader* header =
+            reinterpret_cast< const RecordHeader* >( _data + record.offset );
+        const uint64_t end = record.offset + header->size;
+        uint64_t offset = record.offset + sizeof( RecordHeader );
+        for( uint32_t k = 0; k < record.nCommands; ++k )
+        {
+            uint64_t size = 0;
+            if( offset + sizeof( size ) <= end )
+                ::memcpy( &size, _data + offset, sizeof( size ));
+            if( offset + sizeof( size ) > end ||
+                size > end - offset - sizeof( size ))
+            {
+                LBWARN << "Dropping corrupt record of " << id << " v"
+                       << record.version << " in instance cache file"
+                       << std::endl;
+                i->second.erase( j );
+                if( i->second.empty( ))
+                    _index.erase( i );
+                --_nRecords;
+                return 0;
+            }
+            offset += sizeof( size );
+
+            BufferPtr buffer = new Buffer( &_bufferDeleter );
+            buffer->reset( size );
+            ::memcpy( buffer->getData(), _data + offset, size );
+            offset += _pad( size );
+            buffers.push_back( buffer );
+        }
+    }
+
+    const ObjectVersion rev( id, record.version );
+    size_t nLoaded = 0;
+    for( std::vector< BufferPtr >::const_iterator i = buffers.begin();
+         i != buffers.end(); ++i )
+    {
+        ObjectDataICommand command( localNode, master, *i, false );
+        command.setType( COMMANDTYPE_OBJECT );
+        command.setCommand( CMD_OBJECT_INSTANCE );
+        if( !cache.add( rev, record.instanceID, command, 0 ))
+            break;
+        if( command.isLast( ))
+            ++nLoaded;
+    }
+
+    LBLOG( LOG_OBJECTS ) << "Loaded " << nLoaded << " versions of " << id
+                         << " from instance cache file" << std::endl;
+    return nLoaded;
+}
+
+void InstanceCacheFile::_addRecord( const UUID& id, const Record& record )
+{
+    Records& records = _index[ id ];
+    for( RecordsIter i = records.begin(); i != records.end(); ++i )
+    {
+        if( i->master == record.master )
+        {
+            *i = record; // replace the older version, its data is dead
+            return;
+        }
+    }
+    records.push_back( record );
+    ++_nRecords;
+}
+
+void InstanceCacheFile::_writeVersion( const ObjectVersion& rev,
+                                      const Pending& pending )
+{
+    lunchbox::ScopedMutex<> mutex( _lock );
+    if( _data )
+        _write( rev, pending );
+}
+
+void InstanceCacheFile::_write( const ObjectVersion& rev,
+                                const Pending& pending )
+{
+    const NodeID& master = pending.commands.front().getNode()->getNodeID();
+    RecordHashCIter i = _index.find( rev.identifier );
+    if( i != _index.end( ))
+    {
+        for( RecordsCIter j = i->second.begin(); j != i->second.end(); ++j )
+            if( j->master == master && j->version >= rev.version )
+                return; // have newer version
+    }
+
+    uint64_t size = sizeof( RecordHeader );
+    for( std::vector< ObjectDataICommand >::const_iterator i =
+             pending.commands.begin(); i != pending.commands.end(); ++i )
+    {
+        size += sizeof( uint64_t ) + _pad( i->getBuffer()->getSize( ));
+    }
+
+    if( size > _size - sizeof( FileHeader ))
+    {
+        LBLOG( LOG_OBJECTS ) << "Version " << rev << " with " << size
+                             << " bytes does not fit instance cache file"
+                             << std::endl;
+        return;
+    }
+
+    FileHeader* header = reinterpret_cast< FileHeader* >( _data );
+    if( header->end + size > _size )
+        _compact();
+    if( header->end + size > _size )
+        _reset();
+
+    RecordHeader* record =
+        reinterpret_cast< RecordHeader* >( _data + header->end );
+    record->magic = _magic;
+    record->size = size;
+    record->id[0] = rev.identifier.high();
+    record->id[1] = rev.identifier.low();
+    record->master[0] = master.high();
+    record->master[1] = master.low();
+    record->version[0] = rev.version.high();
+    record->version[1] = rev.version.low();
+    record->instanceID = pending.instanceID;
+    record->nCommands = uint32_t( pending.commands.size( ));
+
+    uint64_t offset = header->end + sizeof( RecordHeader );
+    for( std::vector< ObjectDataICommand >::const_iterator i =
+             pending.commands.begin(); i != pending.commands.end(); ++i )
+    {
+        ConstBufferPtr buffer = i->getBuffer();
+        const uint64_t bufferSize = buffer->getSize();
+        ::memcpy( _data + offset, &bufferSize, sizeof( bufferSize ));
+        offset += sizeof( bufferSize );
+        ::memcpy( _data + offset, buffer->getData(), bufferSize );
+        offset += _pad( bufferSize );
+    }
+
+    const Record entry = { header->end, rev.version, master,
+                           pending.instanceID, record->nCommands };
+    _addRecord( rev.identifier, entry );
+
+    // Publish the record only after it has been written completely
+    header->end += size;
+}
+
+void InstanceCacheFile::_compact()
+{
+    // Move the live records to the front, in file order. The file is
+    // truncated first, so that an interrupted compaction only loses data.
+    typedef std::vector< std::pair< uint64_t, Record* > > RecordPtrs;
+    RecordPtrs records;
+    for( RecordHashIter i = _index.begin(); i != _index.end(); ++i )
+        for( RecordsIter j = i->second.begin(); j != i->second.end(); ++j )
+            records.push_back( std::make_pair( j->offset, &(*j) ));
+    std::sort( records.begin(), records.end( ));
+
+    FileHeader* header = reinterpret_cast< FileHeader* >( _data );
+    const uint64_t oldEnd = header->end;
+    header->end = sizeof( FileHeader );
+
+    uint64_t offset = sizeof( FileHeader );
+    for( RecordPtrs::const_iterator i = records.begin(); i != records.end();
+         ++i )
+    {
+        Record* record = i->second;
+        const RecordHeader* recordHeader =
+            reinterpret_cast< const RecordHeader* >( _data + record->offset );
+        const uint64_t size = recordHeader->size;
+        if( record->offset != offset )
+            ::memmove( _data + offset, _data + record->offset, size );
+        record->offset = offset;
+        offset += size;
+    }
+
+    header->end = offset;
+    LBLOG( LOG_OBJECTS ) << "Compacted instance cache file from " << oldEnd
+                         << " to " << offset << " bytes" << std::endl;
+}
+
+void InstanceCacheFile::_reset()
+{
+    FileHeader* header = reinterpret_cast< FileHeader* >( _data );
+    header->magic = _magic;
+    header->version = _formatVersion;
+    header->end = sizeof( FileHeader );
+    header->reserved = 0;
+
+    _index.clear();
+    _nRecords = 0;
+}
+
+void InstanceCacheFile::_scan()
+{
+    FileHeader* header = reinterpret_cast< FileHeader* >( _data );
+    uint64_t offset = sizeof( FileHeader );
+
+    while( offset + sizeof( RecordHeader ) <= header->end )
+    {
+        const RecordHeader* record =
+            reinterpret_cast< const RecordHeader* >( _data + offset );
+        if( record->magic != _magic || record->size < sizeof( RecordHeader ) ||
+            offset + record->size > header->end )
+        {
+            break;
+        }
+
+        const UUID id( record->id[0], record->id[1] );
+        const Record entry = { offset,
+                               uint128_t( record->version[0],
+                                          record->version[1] ),
+                               NodeID( record->master[0], record->master[1] ),
+                               record->instanceID, record->nCommands };
+        _addRecord( id, entry ); // later records are newer
+        offset += record->size;
+    }
+
+    if( offset != header->end )
+    {
+        LBWARN << "Truncating corrupt instance cache file at " << offset
+               << " bytes" << std::endl;
+        header->end = offset;
+    }
+}
+
+}
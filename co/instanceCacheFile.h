@@ -0,0 +1,153 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CO_INSTANCECACHEFILE_H
+#define CO_INSTANCECACHEFILE_H
+
+#include <co/objectDataICommand.h> // member
+#include <co/objectVersion.h>      // member
+#include <co/types.h>
+
+#include <lunchbox/lock.h>      // member
+#include <lunchbox/stdExt.h>    // member
+
+#include <map>
+#include <vector>
+
+namespace co
+{
+    class InstanceCache;
+    namespace detail { class InstanceCacheFileWriter; }
+
+    /**
+     * @internal A persistent, memory-mapped tier of the InstanceCache.
+     *
+     * Complete instance data versions received by the local node are appended
+     * to a file, keeping only the newest version of each object and master
+     * node. When an object is mapped later, possibly by a restarted process,
+     * the version stored for its master node is loaded into the
+     * InstanceCache, so that the master only has to send newer versions. The
+     * file is a log, which is compacted once it is full.
+     *
+     * Received commands are only queued by add(), the data is copied into the
+     * file by a writer thread, started when needed.
+     */
+    class InstanceCacheFile
+    {
+    public:
+        /** Construct a new, closed cache file. */
+        CO_API InstanceCacheFile();
+
+        /** Destruct this cache file. */
+        CO_API ~InstanceCacheFile();
+
+        /**
+         * Open or create the given file.
+         *
+         * Existing data in the file is kept and indexed.
+         *
+         * @param filename the file name.
+         * @param maxSize the size of the file in bytes.
+         * @return true if the file was opened, false otherwise.
+         */
+        CO_API bool open( const std::string& filename, const uint64_t maxSize );
+
+        /** Close the file. */
+        CO_API void close();
+
+        /** @return true if the file is open. */
+        bool isOpen() const { return _data != 0; }
+
+        /**
+         * Add a received instance data command.
+         *
+         * The version is queued for writing once its last command has been
+         * added.
+         *
+         * @param rev the object identifier and version.
+         * @param instanceID the master instance ID.
+         * @param command The command to add.
+         */
+        CO_API void add( const ObjectVersion& rev, const uint32_t instanceID,
+                         const ObjectDataICommand& command );
+
+        /** Write all queued versions and stop the writer thread. */
+        CO_API void flush();
+
+        /**
+         * Load the stored version of an object into the given cache.
+         *
+         * Only a version received from the given master node is loaded.
+         *
+         * @param id the object identifier.
+         * @param master the node which sent the data.
+         * @param localNode the node receiving the data.
+         * @param cache the cache to fill.
+         * @return the number of versions added to the cache, 0 or 1.
+         */
+        CO_API size_t load( const UUID& id, NodePtr master,
+                            LocalNodePtr localNode, InstanceCache& cache );
+
+        /** @return the number of stored objects, one version per master. */
+        CO_API size_t getSize() const;
+
+    private:
+        struct Record
+        {
+            uint64_t offset;
+            uint128_t version;
+            NodeID master;
+            uint32_t instanceID;
+            uint32_t nCommands;
+        };
+
+        typedef std::vector< Record > Records;
+        typedef Records::iterator RecordsIter;
+        typedef Records::const_iterator RecordsCIter;
+        typedef stde::hash_map< uint128_t, Records > RecordHash;
+        typedef RecordHash::iterator RecordHashIter;
+        typedef RecordHash::const_iterator RecordHashCIter;
+
+        struct Pending
+        {
+            uint32_t instanceID;
+            std::vector< ObjectDataICommand > commands;
+        };
+        typedef std::map< ObjectVersion, Pending > PendingMap;
+
+        PendingMap _pending; //!< incomplete versions, receiver thread only
+
+        mutable lunchbox::Lock _lock; //!< protects the file and the index
+        RecordHash _index;   //!< newest version by object and master
+        size_t _nRecords;
+
+        int _fd;
+        uint8_t* _data;
+        uint64_t _size;
+
+        /** Writes complete versions, started on demand. */
+        detail::InstanceCacheFileWriter* const _writer;
+        friend class detail::InstanceCacheFileWriter;
+
+        void _write( const ObjectVersion& rev, const Pending& pending );
+        void _writeVersion( const ObjectVersion& rev, const Pending& pending );
+        void _addRecord( const UUID& id, const Record& record );
+        void _compact();
+        void _reset();
+        void _scan();
+    };
+}
+#endif //CO_INSTANCECACHEFILE_H
@@ -22,6 +22,8 @@
 #include "buffer.h"
 #include "bufferCache.h"
 #include "commandQueue.h"
+#include "commandStats.h"
+#include "commandTrace.h"
 #include "connectionDescription.h"
 #include "connectionSet.h"
 #include "customICommand.h"
@@ -29,17 +31,20 @@
 #include "exception.h"
 #include "global.h"
 #include "iCommand.h"
+#include "instanceCache.h"
 #include "nodeCommand.h"
 #include "oCommand.h"
 #include "object.h"
 #include "objectICommand.h"
 #include "objectStore.h"
 #include "pipeConnection.h"
+#include "sendTokenScheduler.h"
 #include "worker.h"
 #include "zeroconf.h"
 
 #include <lunchbox/clock.h>
 #include <lunchbox/hash.h>
+#include <lunchbox/lock.h>
 #include <lunchbox/lockable.h>
 #include <lunchbox/log.h>
 #include <lunchbox/requestHandler.h>
@@ -66,6 +71,24 @@ typedef HandlerHash::const_iterator HandlerHashCIter;
 typedef std::pair< LocalNode::CommandHandler, CommandQueue* > CommandPair;
 typedef stde::hash_map< uint128_t, CommandPair > CommandHash;
 typedef CommandHash::const_iterator CommandHashCIter;
+
+/** @return true if the command has at least the given unread payload. */
+bool _hasPayload( ICommand& command, const uint64_t size )
+{
+    // the buffer may contain padding after the payload
+    const uint64_t read = command.getBuffer()->getSize() -
+                          command.getRemainingBufferSize();
+    return command.getSize_() >= read + size;
+}
+
+void _sendGrants( const SendTokenScheduler::Grants& grants )
+{
+    for( SendTokenScheduler::Grants::const_iterator i = grants.begin();
+         i != grants.end(); ++i )
+    {
+        i->node->send( CMD_NODE_ACQUIRE_SEND_TOKEN_REPLY ) << i->requestID;
+    }
+}
 }
 
 namespace detail
@@ -107,14 +130,37 @@ private:
     co::LocalNode* const _localNode;
 };
 
+/** A command thread serving the queued commands of a subset of objects. */
+class ObjectCommandThread : public Worker
+{
+public:
+    ObjectCommandThread( co::LocalNode* localNode, const size_t index )
+        : _localNode( localNode ), _index( index ) {}
+
+protected:
+    virtual bool init()
+        {
+            std::ostringstream name;
+            name << "C" << _index << " " << lunchbox::className( _localNode );
+            setName( name.str( ));
+            return true;
+        }
+
+    virtual bool stopRunning() { return _localNode->isClosed(); }
+
+private:
+    co::LocalNode* const _localNode;
+    const size_t _index;
+};
+typedef std::vector< ObjectCommandThread* > ObjectCommandThreads;
+
 class LocalNode
 {
 public:
     LocalNode()
             : smallBuffers( 200 )
             , bigBuffers( 20 )
-            , sendToken( true )
-            , lastSendToken( 0 )
+            , localBuffers( 20 )
             , objectStore( 0 )
             , receiverThread( 0 )
             , commandThread( 0 )
@@ -135,6 +181,15 @@ public:
             delete commandThread;
             commandThread = 0;
 
+            for( ObjectCommandThreads::const_iterator i =
+                     objectCommandThreads.begin();
+                 i != objectCommandThreads.end(); ++i )
+            {
+                LBASSERT( !(*i)->isRunning( ));
+                delete *i;
+            }
+            objectCommandThreads.clear();
+
             LBASSERT( !receiverThread->isRunning( ));
             delete receiverThread;
             receiverThread = 0;
@@ -151,9 +206,17 @@ public:
     /** The command buffer 'allocator' for big packets */
     co::BufferCache bigBuffers;
 
-    bool sendToken; //!< send token availability.
-    uint64_t lastSendToken; //!< last used time for timeout detection
-    std::deque< co::ICommand > sendTokenQueue; //!< pending requests
+    /** The command buffer 'allocator' for local dispatch by other threads */
+    co::BufferCache localBuffers;
+    lunchbox::Lock localBuffersLock;
+
+    /** The send tokens granted by this node, command thread only */
+    SendTokenScheduler sendTokens;
+
+    /** Send tokens pre-granted to this node by streaming peers */
+    typedef stde::hash_map< uint128_t, uint32_t > SendTokenCounts;
+    lunchbox::Lockable< SendTokenCounts,
+                        lunchbox::SpinLock > preGrantedTokens;
 
     /** Manager of distributed object */
     ObjectStore* objectStore;
@@ -173,6 +236,9 @@ public:
     /** The process-global clock. */
     lunchbox::Clock clock;
 
+    /** The traces of commands handled by this node. */
+    CommandTrace commandTrace;
+
     /** The registered push handlers. */
     lunchbox::Lockable< HandlerHash, lunchbox::Lock > pushHandlers;
 
@@ -182,6 +248,9 @@ public:
     ReceiverThread* receiverThread;
     CommandThread* commandThread;
 
+    /** The command threads for object commands, hashed by object ID */
+    ObjectCommandThreads objectCommandThreads;
+
     lunchbox::Lockable< lunchbox::Servus > service;
 };
 }
@@ -231,6 +300,8 @@ LocalNode::LocalNode( const uint32_t type )
                      CmdFunc( this, &LocalNode::_cmdAcquireSendTokenReply ), 0);
     registerCommand( CMD_NODE_RELEASE_SEND_TOKEN,
                      CmdFunc( this, &LocalNode::_cmdReleaseSendToken ), queue );
+    registerCommand( CMD_NODE_REMOVE_SEND_TOKENS,
+                     CmdFunc( this, &LocalNode::_cmdRemoveSendTokens ), queue );
     registerCommand( CMD_NODE_ADD_LISTENER,
                      CmdFunc( this, &LocalNode::_cmdAddListener ), 0 );
     registerCommand( CMD_NODE_REMOVE_LISTENER,
@@ -238,7 +309,7 @@ LocalNode::LocalNode( const uint32_t type )
     registerCommand( CMD_NODE_PING,
                      CmdFunc( this, &LocalNode::_cmdPing ), queue );
     registerCommand( CMD_NODE_PING_REPLY,
-                     CmdFunc( this, &LocalNode::_cmdDiscard ), 0 );
+                     CmdFunc( this, &LocalNode::_cmdPingReply ), 0 );
     registerCommand( CMD_NODE_COMMAND,
                      CmdFunc( this, &LocalNode::_cmdCommand ), 0 );
 }
@@ -344,6 +415,8 @@ bool LocalNode::listen()
                << std::endl;
     }
 
+    _impl->sendTokens.setMaxTokens( _getNumSendTokens( ));
+
     LBVERB << lunchbox::className(this) << " start command and receiver thread "
            << std::endl;
 
@@ -540,6 +613,10 @@ void LocalNode::_closeNode( NodePtr node )
     }
 
     _impl->objectStore->removeInstanceData( node->getNodeID( ));
+    {
+        lunchbox::ScopedFastWrite mutex( _impl->preGrantedTokens );
+        _impl->preGrantedTokens->erase( node->getNodeID( ));
+    }
 
     lunchbox::ScopedFastWrite mutex( _impl->nodes );
     _impl->nodes->erase( node->getNodeID( ));
@@ -607,7 +684,7 @@ void LocalNode::ackRequest( NodePtr node, const uint32_t requestID )
 void LocalNode::ping( NodePtr peer )
 {
     LBASSERT( !_impl->inReceiverThread( ));
-    peer->send( CMD_NODE_PING );
+    peer->send( CMD_NODE_PING ) << CommandStats::getTime();
 }
 
 bool LocalNode::pingIdleNodes()
@@ -625,7 +702,7 @@ bool LocalNode::pingIdleNodes()
         {
             LBINFO << " Ping Node: " <<  node->getNodeID() << " last seen "
                    << node->getLastReceiveTime() << std::endl;
-            node->send( CMD_NODE_PING );
+            node->send( CMD_NODE_PING ) << CommandStats::getTime();
             pinged = true;
         }
     }
@@ -645,6 +722,16 @@ void LocalNode::expireInstanceData( const int64_t age )
     _impl->objectStore->expireInstanceData( age );
 }
 
+InstanceCacheStats LocalNode::getInstanceCacheStats() const
+{
+    return _impl->objectStore->getInstanceCacheStats();
+}
+
+bool LocalNode::enableInstanceCacheFile( const std::string& filename )
+{
+    return _impl->objectStore->enableInstanceCacheFile( filename );
+}
+
 void LocalNode::enableSendOnRegister()
 {
     _impl->objectStore->enableSendOnRegister();
@@ -699,6 +786,29 @@ void LocalNode::swapObject( Object* oldObject, Object* newObject )
     _impl->objectStore->swapObject( oldObject, newObject );
 }
 
+void LocalNode::decode( ObjectDataIStream* stream )
+{
+    _impl->objectStore->decode( stream );
+}
+
+Dispatcher* LocalNode::getLocalDispatcher( const UUID& id,
+                                          const uint32_t instanceID,
+                                          const uint32_t cmd )
+{
+    if( _impl->objectStore->isUnordered( id, instanceID, cmd ))
+        return _impl->objectStore;
+    return 0;
+}
+
+void LocalNode::ackMaxVersion( NodePtr master, const UUID& id,
+                               const uint32_t masterInstanceID,
+                               const uint64_t maxVersion,
+                               const uint32_t slaveInstanceID )
+{
+    _impl->objectStore->ackMaxVersion( master, id, masterInstanceID,
+                                       maxVersion, slaveInstanceID );
+}
+
 void LocalNode::releaseObject( Object* object )
 {
     LBASSERT( object );
@@ -749,13 +859,25 @@ bool LocalNode::registerCommandHandler( const uint128_t& command,
     return true;
 }
 
-LocalNode::SendToken LocalNode::acquireSendToken( NodePtr node )
+LocalNode::SendToken LocalNode::acquireSendToken( NodePtr node,
+                                                  const uint32_t weight )
 {
     LBASSERT( !inCommandThread( ));
     LBASSERT( !_impl->inReceiverThread( ));
 
+    {
+        lunchbox::ScopedFastWrite mutex( _impl->preGrantedTokens );
+        detail::LocalNode::SendTokenCounts::iterator i =
+            _impl->preGrantedTokens->find( node->getNodeID( ));
+        if( i != _impl->preGrantedTokens->end() && i->second > 0 )
+        {
+            --i->second;
+            return node;
+        }
+    }
+
     const uint32_t requestID = registerRequest();
-    node->send( CMD_NODE_ACQUIRE_SEND_TOKEN ) << requestID;
+    node->send( CMD_NODE_ACQUIRE_SEND_TOKEN ) << requestID << weight;
 
     bool ret = false;
     if( waitRequest( requestID, ret, Global::getTimeout( )))
@@ -766,13 +888,29 @@ LocalNode::SendToken LocalNode::acquireSendToken( NodePtr node )
     return 0;
 }
 
-void LocalNode::releaseSendToken( SendToken& node )
+void LocalNode::releaseSendToken( SendToken& node, const bool streaming )
 {
     LBASSERT( !_impl->inReceiverThread( ));
     if( !node )
         return;
 
-    node->send( CMD_NODE_RELEASE_SEND_TOKEN );
+    node->send( CMD_NODE_RELEASE_SEND_TOKEN ) << streaming;
+    if( !streaming ) // return unused pre-granted tokens
+    {
+        uint32_t nTokens = 0;
+        {
+            lunchbox::ScopedFastWrite mutex( _impl->preGrantedTokens );
+            detail::LocalNode::SendTokenCounts::iterator i =
+                _impl->preGrantedTokens->find( node->getNodeID( ));
+            if( i != _impl->preGrantedTokens->end( ))
+            {
+                nTokens = i->second;
+                _impl->preGrantedTokens->erase( i );
+            }
+        }
+        for( uint32_t i = 0; i < nTokens; ++i )
+            node->send( CMD_NODE_RELEASE_SEND_TOKEN ) << false;
+    }
     node = 0; // In case app stores token in member variable
 }
 
@@ -1077,11 +1215,43 @@ CommandQueue* LocalNode::getCommandThreadQueue()
     return _impl->commandThread->getWorkerQueue();
 }
 
+CommandQueue* LocalNode::getCommandThreadQueue( const UUID& objectID )
+{
+    const detail::ObjectCommandThreads& threads = _impl->objectCommandThreads;
+    if( threads.empty( ))
+        return getCommandThreadQueue();
+
+    const uint64_t hash = objectID.high() ^ objectID.low();
+    return threads[ hash % threads.size() ]->getWorkerQueue();
+}
+
 bool LocalNode::inCommandThread() const
 {
     return _impl->commandThread->isCurrent();
 }
 
+CommandStats LocalNode::getCommandStats() const
+{
+    CommandStats stats;
+    stats.update();
+    return stats;
+}
+
+void LocalNode::resetCommandStats()
+{
+    CommandStats::reset();
+}
+
+CommandTrace& LocalNode::getCommandTrace()
+{
+    return _impl->commandTrace;
+}
+
+void LocalNode::exportCommandTrace( std::ostream& os ) const
+{
+    _impl->commandTrace.write( os, getNodeID( ));
+}
+
 int64_t LocalNode::getTime64() const
 {
     return _impl->clock.getTime64();
@@ -1163,6 +1333,12 @@ void LocalNode::_runReceiverThread()
 
     _impl->pendingCommands.clear();
     LBCHECK( _impl->commandThread->join( ));
+    for( detail::ObjectCommandThreads::const_iterator i =
+             _impl->objectCommandThreads.begin();
+         i != _impl->objectCommandThreads.end(); ++i )
+    {
+        LBCHECK( (*i)->join( ));
+    }
 
     ConnectionPtr connection = getConnection();
     PipeConnectionPtr pipe = LBSAFECAST( PipeConnection*, connection.get( ));
@@ -1186,6 +1362,10 @@ void LocalNode::_runReceiverThread()
     _impl->pendingCommands.clear();
     _impl->smallBuffers.flush();
     _impl->bigBuffers.flush();
+    {
+        lunchbox::ScopedMutex<> mutex( _impl->localBuffersLock );
+        _impl->localBuffers.flush();
+    }
 
     LBINFO << "Leaving receiver thread of " << lunchbox::className( this )
            << std::endl;
@@ -1221,6 +1401,8 @@ void LocalNode::_handleDisconnect()
         // local command dispatching
         OCommand( this, this, CMD_NODE_REMOVE_NODE )
                 << node.get() << uint32_t( LB_UNDEFINED_UINT32 );
+        OCommand( this, this, CMD_NODE_REMOVE_SEND_TOKENS )
+                << node->getNodeID();
 
         if( node->getConnection() == connection )
             _closeNode( node );
@@ -1363,7 +1545,14 @@ bool LocalNode::_readTail( ICommand& command, BufferPtr buffer,
 
 BufferPtr LocalNode::allocBuffer( const uint64_t size )
 {
-    LBASSERT( _impl->receiverThread->isStopped() || _impl->inReceiverThread( ));
+    if( !_impl->receiverThread->isStopped() && !_impl->inReceiverThread( ))
+    {
+        // local command dispatch from application threads
+        lunchbox::ScopedMutex<> mutex( _impl->localBuffersLock );
+        _impl->localBuffers.compact();
+        return _impl->localBuffers.alloc( size );
+    }
+
     BufferPtr buffer = size > co::Buffer::getCacheSize() ?
         _impl->bigBuffers.alloc( size ) :
         _impl->smallBuffers.alloc( Buffer::getCacheSize( ));
@@ -1480,6 +1669,21 @@ Zeroconf LocalNode::getZeroconf()
 //----------------------------------------------------------------------
 bool LocalNode::_startCommandThread()
 {
+    detail::ObjectCommandThreads& threads = _impl->objectCommandThreads;
+    if( threads.empty( ))
+    {
+        const int32_t nThreads =
+            Global::getIAttribute( Global::IATTR_OBJECT_COMMAND_THREADS );
+        for( int32_t i = 0; i < nThreads; ++i )
+            threads.push_back( new detail::ObjectCommandThread( this, i ));
+    }
+
+    for( detail::ObjectCommandThreads::const_iterator i = threads.begin();
+         i != threads.end(); ++i )
+    {
+        if( !(*i)->start( ))
+            return false;
+    }
     return _impl->commandThread->start();
 }
 
@@ -1516,6 +1720,16 @@ bool LocalNode::_cmdStopCmd( ICommand& command )
     LBASSERTINFO( isClosing(), *this );
 
     _setClosed();
+
+    // wake up object command threads, which exit once the node is closed
+    for( detail::ObjectCommandThreads::const_iterator i =
+             _impl->objectCommandThreads.begin();
+         i != _impl->objectCommandThreads.end(); ++i )
+    {
+        ICommand wakeup( command );
+        wakeup.setDispatchFunction( CmdFunc( this, &LocalNode::_cmdDiscard ));
+        (*i)->getWorkerQueue()->push( wakeup );
+    }
     return true;
 }
 
@@ -1844,56 +2058,75 @@ bool LocalNode::_cmdGetNodeDataReply( ICommand& command )
 bool LocalNode::_cmdAcquireSendToken( ICommand& command )
 {
     LBASSERT( inCommandThread( ));
-    if( !_impl->sendToken == 0 ) // enqueue command if no token available
-    {
-        const uint32_t timeout = Global::getTimeout();
-        if( timeout == LB_TIMEOUT_INDEFINITE ||
-            ( getTime64() - _impl->lastSendToken <= timeout ))
-        {
-            _impl->sendTokenQueue.push_back( command );
-            return true;
-        }
-
-        // timeout! - clear old requests
-        _impl->sendTokenQueue.clear();
-        // 'generate' new token - release is robust
-    }
-
-    _impl->sendToken = false;
-
     const uint32_t requestID = command.get< uint32_t >();
-    command.getNode()->send( CMD_NODE_ACQUIRE_SEND_TOKEN_REPLY ) << requestID;
+    const uint32_t weight = command.get< uint32_t >();
+
+    SendTokenScheduler::Grants grants;
+    _impl->sendTokens.request( command.getNode(), requestID, weight,
+                               getTime64(), grants );
+    _sendGrants( grants );
     return true;
 }
 
 bool LocalNode::_cmdAcquireSendTokenReply( ICommand& command )
 {
     const uint32_t requestID = command.get< uint32_t >();
-    serveRequest( requestID );
+    if( requestID != LB_UNDEFINED_UINT32 )
+    {
+        serveRequest( requestID );
+        return true;
+    }
+
+    // unsolicited token for a streaming sender
+    lunchbox::ScopedFastWrite mutex( _impl->preGrantedTokens );
+    ++( *_impl->preGrantedTokens )[ command.getNode()->getNodeID() ];
     return true;
 }
 
-bool LocalNode::_cmdReleaseSendToken( ICommand& )
+bool LocalNode::_cmdReleaseSendToken( ICommand& command )
 {
     LBASSERT( inCommandThread( ));
-    _impl->lastSendToken = getTime64();
+    const bool streaming = command.get< bool >();
 
-    if( _impl->sendToken )
-        return true; // double release due to timeout
-    if( _impl->sendTokenQueue.empty( ))
-    {
-        _impl->sendToken = true;
-        return true;
-    }
-
-    ICommand& request = _impl->sendTokenQueue.front();
-    _impl->sendTokenQueue.pop_front();
+    SendTokenScheduler::Grants grants;
+    _impl->sendTokens.release( command.getNode(), streaming, getTime64(),
+                               grants );
+    _sendGrants( grants );
+    return true;
+}
 
-    const uint32_t requestID = request.get< uint32_t >();
-    request.getNode()->send( CMD_NODE_ACQUIRE_SEND_TOKEN_REPLY ) << requestID;
+bool LocalNode::_cmdRemoveSendTokens( ICommand& command )
+{
+    LBASSERT( inCommandThread( ));
+    SendTokenScheduler::Grants grants;
+    _impl->sendTokens.remove( command.get< NodeID >(), grants );
+    _sendGrants( grants );
     return true;
 }
 
+uint32_t LocalNode::_getNumSendTokens() const
+{
+    const int32_t nTokens = Global::getIAttribute(
+        Global::IATTR_NODE_SEND_TOKENS );
+    if( nTokens > 0 )
+        return nTokens;
+
+    // auto: one token per share of the fastest listening connection
+    const int32_t tokenBandwidth = Global::getIAttribute(
+        Global::IATTR_NODE_SEND_TOKEN_BANDWIDTH );
+    if( tokenBandwidth <= 0 )
+        return 1;
+
+    int32_t bandwidth = 0;
+    const ConnectionDescriptions& descriptions = getConnectionDescriptions();
+    for( ConnectionDescriptionsCIter i = descriptions.begin();
+         i != descriptions.end(); ++i )
+    {
+        bandwidth = LB_MAX( bandwidth, (*i)->bandwidth );
+    }
+    return LB_MAX( bandwidth / tokenBandwidth, 1 );
+}
+
 bool LocalNode::_cmdAddListener( ICommand& command )
 {
     Connection* rawConnection = (Connection*)(command.get< uint64_t >( ));
@@ -1951,7 +2184,32 @@ bool LocalNode::_cmdRemoveListener( ICommand& command )
 bool LocalNode::_cmdPing( ICommand& command )
 {
     LBASSERT( inCommandThread( ));
-    command.getNode()->send( CMD_NODE_PING_REPLY );
+    if( !_hasPayload( command, sizeof( int64_t )))
+    {
+        // ping of a peer without clock offset estimation
+        command.getNode()->send( CMD_NODE_PING_REPLY );
+        return true;
+    }
+
+    const int64_t pingTime = command.get< int64_t >();
+    command.getNode()->send( CMD_NODE_PING_REPLY )
+        << pingTime << CommandStats::getTime();
+    return true;
+}
+
+bool LocalNode::_cmdPingReply( ICommand& command )
+{
+    const int64_t now = CommandStats::getTime();
+    if( !_hasPayload( command, 2 * sizeof( int64_t )))
+        return true; // reply of a peer without clock offset estimation
+
+    const int64_t pingTime = command.get< int64_t >();
+    const int64_t remoteTime = command.get< int64_t >();
+
+    // assume symmetric latency: remote time was taken halfway through
+    const int64_t rtt = now - pingTime;
+    _impl->commandTrace.addClockOffset( command.getNode()->getNodeID(),
+                                        remoteTime - pingTime - rtt / 2, rtt );
     return true;
 }
 
@@ -166,6 +166,26 @@ namespace detail { class LocalNode; class ReceiverThread; class CommandThread; }
         /** @internal */
         CO_API void expireInstanceData( const int64_t age );
 
+        /**
+         * @return the hit, miss, eviction and size statistics of the instance
+         *         cache, see co/instanceCache.h.
+         */
+        CO_API InstanceCacheStats getInstanceCacheStats() const;
+
+        /**
+         * Keep the instance cache persistently in the given file.
+         *
+         * Instance data received by this node is written to the file, and
+         * loaded from it when an object of the same master node is mapped
+         * again, e.g., after this process was restarted. The file size is set
+         * by Global::IATTR_INSTANCE_CACHE_FILE_SIZE. Has to be called before
+         * the node is listening.
+         *
+         * @param filename the name of the cache file.
+         * @return true if the file was opened, false otherwise.
+         */
+        CO_API bool enableInstanceCacheFile( const std::string& filename );
+
         /**
          * Enable sending instance data after registration.
          *
@@ -338,15 +358,68 @@ namespace detail { class LocalNode; class ReceiverThread; class CommandThread; }
         /** Assemble a vector of the currently connected nodes. */
         CO_API void getNodes( Nodes& nodes, const bool addSelf = true ) const;
 
-        /** Return the command queue to the command thread. */
+        /**
+         * Return the command queue to the command thread.
+         *
+         * The command thread serves all node-level commands, e.g., object
+         * registration and mapping, in order. Their handlers do not need to be
+         * thread-safe with respect to each other.
+         */
         CO_API CommandQueue* getCommandThreadQueue();
 
+        /**
+         * Return the command queue serving the commands of the given object.
+         *
+         * Object commands are served by a pool of
+         * Global::IATTR_OBJECT_COMMAND_THREADS threads besides the command
+         * thread, so that expensive node-level commands, e.g., the mapping of
+         * a large object, do not delay them. All commands of one object are
+         * served by the same thread in order, but concurrently with the
+         * commands of other objects and with the command thread. Object
+         * command handlers using this queue therefore have to protect state
+         * shared with other objects or with node-level handlers, which is the
+         * case for the Barrier and QueueMaster commands.
+         *
+         * @param objectID the identifier of the object.
+         * @return the command queue for the object.
+         * @version 1.0
+         */
+        CO_API CommandQueue* getCommandThreadQueue( const UUID& objectID );
+
         /**
          * @return true if executed from the command handler thread, false if
-         *         not.
+         *         not. Object command threads are not considered.
          */
         CO_API bool inCommandThread() const;
 
+        /**
+         * @return the dispatch statistics of all commands handled by this
+         *         process. Print the result to dump the statistics.
+         * @version 1.0
+         */
+        CO_API CommandStats getCommandStats() const;
+
+        /** Clear the dispatch statistics of this process. @version 1.0 */
+        CO_API void resetCommandStats();
+
+        /**
+         * Write the latency traces of the commands handled by this node.
+         *
+         * Commands are traced when Global::IATTR_COMMAND_TRACE is set to the
+         * number of traces to keep. The sender, receive, dispatch, queue and
+         * handler times of each command are written in the Chrome trace event
+         * JSON format. The send times of remote commands are only available
+         * after the sending node has been pinged.
+         *
+         * @param os the output stream.
+         * @version 1.0
+         * @sa ping()
+         */
+        CO_API void exportCommandTrace( std::ostream& os ) const;
+
+        /** @internal @return the command trace of this node. */
+        CommandTrace& getCommandTrace();
+
         /** @internal */
         CO_API int64_t getTime64() const;
         //@}
@@ -373,7 +446,10 @@ namespace detail { class LocalNode; class ReceiverThread; class CommandThread; }
          */
         CO_API void flushCommands();
 
-        /** @internal Allocate a command buffer from the receiver thread. */
+        /**
+         * @internal Allocate a command buffer from the receiver thread, or
+         * for local command dispatch from any other thread.
+         */
         CO_API BufferPtr allocBuffer( const uint64_t size );
 
         /**
@@ -386,20 +462,74 @@ namespace detail { class LocalNode; class ReceiverThread; class CommandThread; }
         CO_API virtual bool dispatchCommand( ICommand& command );
 
         /**
-         * Acquire a singular send token from the given node.
+         * Acquire a send token from the given node.
+         *
+         * A node grants a limited number of concurrent send tokens, which
+         * should be held for the duration of bulk data transfers to it. The
+         * tokens are shared between the requesting nodes proportionally to
+         * the weight of their requests. The number of tokens is set by
+         * IATTR_NODE_SEND_TOKENS, or derived from the bandwidth of the
+         * listening connections of the node.
+         *
+         * @param toNode the node to send data to.
+         * @param weight the relative share of the requesting node.
          * @return The send token to release.
+         * @version 1.0
+         */
+        CO_API SendToken acquireSendToken( NodePtr toNode,
+                                           const uint32_t weight = 1 );
+
+        /**
+         * Release a send token.
+         *
+         * Streaming senders may be pre-granted their next token, so that
+         * the next acquireSendToken() does not wait for a round trip. A
+         * non-streaming release returns unused pre-granted tokens.
+         *
+         * @param token the token to release.
+         * @param streaming true if more data will be sent to the node soon.
+         * @version 1.0
          */
-        CO_API SendToken acquireSendToken( NodePtr toNode );
-        CO_API void releaseSendToken( SendToken& token );
+        CO_API void releaseSendToken( SendToken& token,
+                                      const bool streaming = false );
 
         /** @return a Zeroconf communicator handle for this node. */
         CO_API Zeroconf getZeroconf();
         //@}
 
+        /** @internal Decode a ready slave stream in a separate thread. */
+        void decode( ObjectDataIStream* stream );
+
         /** @internal Ack an operation to the sender. */
         CO_API void ackRequest( NodePtr node, const uint32_t requestID );
 
-        /** Request keep-alive update from the remote node. */
+        /**
+         * @internal
+         * Queue a max version acknowledgement of a slave object.
+         *
+         * Acknowledgements to the same master are aggregated and sent as one
+         * command by the command thread.
+         */
+        void ackMaxVersion( NodePtr master, const UUID& id,
+                            const uint32_t masterInstanceID,
+                            const uint64_t maxVersion,
+                            const uint32_t slaveInstanceID );
+
+        /**
+         * @internal
+         * @return the dispatcher for a local object command bypassing the
+         *         self connection, or 0.
+         */
+        Dispatcher* getLocalDispatcher( const UUID& id,
+                                        const uint32_t instanceID,
+                                        const uint32_t cmd );
+
+        /**
+         * Request keep-alive update from the remote node.
+         *
+         * The reply also updates the clock offset to the remote node used by
+         * exportCommandTrace().
+         */
         CO_API void ping( NodePtr remoteNode );
 
         /**
@@ -456,6 +586,7 @@ namespace detail { class LocalNode; class ReceiverThread; class CommandThread; }
         void _closeNode( NodePtr node );
         CO_API void _addConnection( ConnectionPtr connection );
         void _removeConnection( ConnectionPtr connection );
+        uint32_t _getNumSendTokens() const;
 
         NodePtr _connect( const NodeID& nodeID, NodePtr peer );
         NodePtr _connectFromZeroconf( const NodeID& nodeID );
@@ -499,9 +630,11 @@ namespace detail { class LocalNode; class ReceiverThread; class CommandThread; }
         bool _cmdAcquireSendToken( ICommand& command );
         bool _cmdAcquireSendTokenReply( ICommand& command );
         bool _cmdReleaseSendToken( ICommand& command );
+        bool _cmdRemoveSendTokens( ICommand& command );
         bool _cmdAddListener( ICommand& command );
         bool _cmdRemoveListener( ICommand& command );
         bool _cmdPing( ICommand& command );
+        bool _cmdPingReply( ICommand& command );
         bool _cmdCommand( ICommand& command );
         bool _cmdCommandAsync( ICommand& command );
         bool _cmdDiscard( ICommand& ) { return true; }
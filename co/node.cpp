@@ -18,7 +18,9 @@
 
 #include "node.h"
 
+#include "connection.h"
 #include "connectionDescription.h"
+#include "connectionStats.h"
 #include "customOCommand.h"
 #include "nodeCommand.h"
 #include "oCommand.h"
@@ -308,6 +310,19 @@ ConnectionPtr Node::getMulticast() const
     return _impl->outMulticast.data;
 }
 
+ConnectionStats Node::getConnectionStats() const
+{
+    ConnectionStats stats;
+    ConnectionPtr connection = _impl->outgoing;
+    if( connection )
+        stats += connection->getStats();
+
+    connection = _impl->outMulticast.data;
+    if( connection )
+        stats += connection->getStats();
+    return stats;
+}
+
 OCommand Node::send( const uint32_t cmd, const bool multicast )
 {
     ConnectionPtr connection = multicast ? useMulticast() : 0;
@@ -95,6 +95,15 @@ namespace detail { class Node; }
 
         /** @return the first usable multicast connection to this node, or 0. */
         ConnectionPtr useMulticast();
+
+        /**
+         * @return the summed I/O statistics of the connections to this node.
+         *
+         * The multicast connection is included, it is shared by all nodes of
+         * the same multicast group.
+         * @version 1.0
+         */
+        CO_API ConnectionStats getConnectionStats() const;
         //@}
 
         /** @name Messaging API */
@@ -65,7 +65,10 @@ namespace co
         CMD_NODE_OBJECT_PUSH,
         CMD_NODE_COMMAND,
         CMD_NODE_PING,
-        CMD_NODE_PING_REPLY
+        CMD_NODE_PING_REPLY,
+        CMD_NODE_OBJECT_MAX_VERSIONS,
+        CMD_NODE_FLUSH_MAX_VERSIONS,
+        CMD_NODE_REMOVE_SEND_TOKENS
         // check that not more then CMD_NODE_CUSTOM have been defined!
     };
 }
@@ -18,6 +18,8 @@
 #include "oCommand.h"
 
 #include "buffer.h"
+#include "commandStats.h"
+#include "commandTrace.h"
 #include "iCommand.h"
 
 namespace co
@@ -152,7 +154,17 @@ void OCommand::_init( const uint32_t cmd, const uint32_t type )
 #endif
     enableSave();
     _enable();
-    *this << 0ull /* size */ << type << cmd;
+    if( CommandTrace::isEnabled( ))
+        *this << 0ull /* size */ << ( type | CommandTrace::COMMANDTYPE_TRACED )
+              << cmd << CommandStats::getTime();
+    else
+        writeHeader( *this, cmd, type );
+}
+
+void OCommand::writeHeader( DataOStream& os, const uint32_t cmd,
+                            const uint32_t type )
+{
+    os << 0ull /* size */ << type << cmd;
 }
 
 void OCommand::sendData( const void* buffer, const uint64_t size,
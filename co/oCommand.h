@@ -77,6 +77,10 @@ public:
     /** @return the static size of this command. */
     CO_API static size_t getSize();
 
+    /** @internal Write the header of an untraced command to a stream. */
+    CO_API static void writeHeader( DataOStream& os, const uint32_t cmd,
+                                    const uint32_t type );
+
 protected:
     CO_API virtual void sendData( const void* buffer, const uint64_t size,
                                   const bool last );
@@ -148,6 +148,17 @@ void Object::setID( const UUID& identifier )
 ObjectOCommand Object::send( NodePtr node, const uint32_t cmd,
                              const uint32_t instanceID )
 {
+    LocalNodePtr localNode = getLocalNode();
+    if( node.get() == localNode.get( )) // OPT: bypass the self connection
+    {
+        Dispatcher* dispatcher = localNode->getLocalDispatcher( _id,
+                                                                instanceID,
+                                                                cmd );
+        if( dispatcher )
+            return ObjectOCommand( dispatcher, localNode, cmd,
+                                   COMMANDTYPE_OBJECT, _id, instanceID );
+    }
+
     Connections connections( 1, node->getConnection( ));
     return ObjectOCommand( connections, cmd, COMMANDTYPE_OBJECT, _id,
                            instanceID );
@@ -255,6 +266,12 @@ void Object::removeSlaves( NodePtr node )
     _cm->removeSlaves( node );
 }
 
+void Object::setSlaveMaxVersion( NodePtr node, const uint32_t instanceID,
+                                 const uint64_t maxVersion )
+{
+    _cm->setSlaveMaxVersion( node, instanceID, maxVersion );
+}
+
 void Object::setMasterNode( NodePtr node )
 {
     _cm->setMasterNode( node );
@@ -322,6 +322,11 @@ namespace co
          * will be send after the command object is destroyed, aka when it is
          * running out of scope.
          *
+         * If the node is the local node and a single local instance handles
+         * the command in a command queue and has set it unordered, the command
+         * is pushed directly to this queue instead of being sent through the
+         * node's connection.
+         *
          * @param node the node where to send the command to
          * @param cmd the object command to execute
          * @param instanceID the object instance which should handle the command
@@ -379,6 +384,9 @@ namespace co
         void addSlave( MasterCMCommand& command );
         CO_API void removeSlave( NodePtr node, const uint32_t instanceID );
         CO_API void removeSlaves( NodePtr node ); //!< @internal
+        /** @internal */
+        void setSlaveMaxVersion( NodePtr node, const uint32_t instanceID,
+                                 const uint64_t maxVersion );
         void setMasterNode( NodePtr node ); //!< @internal
         /** @internal */
         void addInstanceDatas( const ObjectDataIStreamDeque&, const uint128_t&);
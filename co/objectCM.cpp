@@ -37,6 +37,7 @@ namespace co
 {
 ObjectCM::ObjectCM( Object* object )
         : _object( object )
+        , _compressionSkips( 0 )
 {}
 
 void ObjectCM::push( const uint128_t& groupID, const uint128_t& typeID,
@@ -24,10 +24,8 @@
 #include <co/objectVersion.h> // VERSION_FOO values
 #include <co/types.h>
 
+#include <lunchbox/atomic.h> // member
 //#define EQ_INSTRUMENT_MULTICAST
-#ifdef EQ_INSTRUMENT_MULTICAST
-#  include <lunchbox/atomic.h>
-#endif
 
 namespace co
 {
@@ -126,6 +124,17 @@ namespace co
         /** Remove all subscribed slaves from the given node. */
         virtual void removeSlaves( NodePtr node ) = 0;
 
+        /**
+         * Update the maximum version a subscribed slave can accept.
+         *
+         * @param node the slave node.
+         * @param instanceID the slave's instance identifier.
+         * @param maxVersion the maximum version to commit for the slave.
+         */
+        virtual void setSlaveMaxVersion( NodePtr node,
+                                         const uint32_t instanceID,
+                                         const uint64_t maxVersion ) {}
+
         /** @return the vector of current slave nodes. */
         virtual const Nodes getSlaveNodes() const { return Nodes(); }
 
@@ -144,6 +153,10 @@ namespace co
         /** @internal @return the object. */
         const Object* getObject( ) const { return _object; }
 
+        /** @internal @return the compressions to skip for the object data. */
+        lunchbox::a_int32_t& getCompressionSkips() const
+            { return _compressionSkips; }
+
         /** @internal Swap the object. */
         void setObject( Object* object )
             { LBASSERT( object ); _object = object; }
@@ -155,6 +168,9 @@ namespace co
         /** The managed object. */
         Object* _object;
 
+        /** Shared by all output streams, see DataOStream::_setCompressionSkips */
+        mutable lunchbox::a_int32_t _compressionSkips;
+
 #ifdef EQ_INSTRUMENT_MULTICAST
         static lunchbox::a_int32_t _hit;
         static lunchbox::a_int32_t _miss;
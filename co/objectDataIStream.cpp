@@ -22,11 +22,32 @@
 #include "objectDataICommand.h"
 
 #include <co/plugins/compressor.h>
+#include <lunchbox/scopedMutex.h>
 
 namespace co
 {
+namespace
+{
+/** @return the payload after the header of an object data command. */
+const void* _getChunkData( ObjectDataICommand& command )
+{
+    switch( command.getCommand( ))
+    {
+      case CMD_OBJECT_INSTANCE:
+        command.get< NodeID >();    // nodeID
+        command.get< uint32_t >();  // instanceID
+        break;
+      case CMD_OBJECT_SLAVE_DELTA:
+        command.get< UUID >();      // commit UUID
+        break;
+    }
+    return command.getRemainingBuffer( command.getRemainingBufferSize( ));
+}
+}
+
 ObjectDataIStream::ObjectDataIStream()
     : DataIStream( false )
+    , _decoding( false )
 {
     _reset();
 }
@@ -34,8 +55,15 @@ ObjectDataIStream::ObjectDataIStream()
 ObjectDataIStream::ObjectDataIStream( const ObjectDataIStream& from )
         : DataIStream( from )
         , _commands( from._commands )
+        , _decoding( false )
+        , _received( uint32_t( from._commands.size( )))
+        , _consumed( 0 )
+        , _lastConsumed( false )
+        , _pendingVersion( from._pendingVersion )
         , _version( from._version )
 {
+    LBASSERT( !from._decoding );
+    LBASSERT( from._decoded.empty( ));
 }
 
 ObjectDataIStream::~ObjectDataIStream()
@@ -51,8 +79,15 @@ void ObjectDataIStream::reset()
 
 void ObjectDataIStream::_reset()
 {
+    _decoding.waitEQ( false );
     _usedCommand.clear();
     _commands.clear();
+    _decoded.clear();
+    _usedBuffer.clear();
+    _received = 0;
+    _consumed = 0;
+    _lastConsumed = false;
+    _pendingVersion = VERSION_INVALID;
     _version = VERSION_INVALID;
 }
 
@@ -61,55 +96,61 @@ void ObjectDataIStream::addDataCommand( ObjectDataICommand command )
     LB_TS_THREAD( _thread );
     LBASSERT( !isReady( ));
 
-#ifndef NDEBUG
     const uint128_t& version = command.getVersion();
+#ifndef NDEBUG
     const uint32_t sequence = command.getSequence();
 
-    if( _commands.empty( ))
-    {
-        LBASSERTINFO( sequence == 0, sequence << " in " << command );
-    }
-    else
-    {
-        ObjectDataICommand previous( _commands.back() );
-        const uint128_t& previousVersion = previous.getVersion();
-        const uint32_t previousSequence = previous.getSequence();
-        LBASSERTINFO( sequence == previousSequence+1,
-                      sequence << ", " << previousSequence );
-        LBASSERT( version == previousVersion );
-    }
+    LBASSERTINFO( sequence == _received.get(),
+                  sequence << " in " << command << ", expected "
+                  << _received.get( ));
+    LBASSERT( _received == 0 || version == _pendingVersion );
 #endif
 
-    _commands.push_back( command );
+    _pendingVersion = version;
+    {
+        lunchbox::ScopedFastWrite mutex( _lock );
+        _commands.push_back( command );
+    }
+    // count before setting ready, a streaming reader relies on the order
+    ++_received;
     if( command.isLast( ))
         _setReady();
 }
 
 bool ObjectDataIStream::hasInstanceData() const
 {
-    if( !_usedCommand.isValid() && _commands.empty( ))
+    if( _usedCommand.isValid( ))
+        return _usedCommand.getCommand() == CMD_OBJECT_INSTANCE;
+
+    lunchbox::ScopedFastRead mutex( _lock );
+    if( _commands.empty( ))
     {
         LBUNREACHABLE;
         return false;
     }
-
-    const ICommand& command = _usedCommand.isValid() ? _usedCommand :
-                                                      _commands.front();
-    return( command.getCommand() == CMD_OBJECT_INSTANCE );
+    return _commands.front().getCommand() == CMD_OBJECT_INSTANCE;
 }
 
 NodePtr ObjectDataIStream::getMaster()
 {
-    if( !_usedCommand.isValid() && _commands.empty( ))
+    if( _usedCommand.isValid( ))
+        return _usedCommand.getNode();
+
+    lunchbox::ScopedFastRead mutex( _lock );
+    if( _commands.empty( ))
         return 0;
+    return _commands.front().getNode();
+}
 
-    const ICommand& command = _usedCommand.isValid() ? _usedCommand :
-                                                      _commands.front();
-    return command.getNode();
+size_t ObjectDataIStream::nRemainingBuffers() const
+{
+    lunchbox::ScopedFastRead mutex( _lock );
+    return _commands.size();
 }
 
 size_t ObjectDataIStream::getDataSize() const
 {
+    lunchbox::ScopedFastRead mutex( _lock );
     size_t size = 0;
     typedef CommandDeque::const_iterator CommandDequeCIter;
     for( CommandDequeCIter i = _commands.begin(); i != _commands.end(); ++i )
@@ -120,18 +161,55 @@ size_t ObjectDataIStream::getDataSize() const
     return size;
 }
 
+uint128_t ObjectDataIStream::getVersion() const
+{
+    if( isReady( ))
+        return _version.get();
+    return _received > 0 ? _pendingVersion : VERSION_INVALID;
+}
+
 uint128_t ObjectDataIStream::getPendingVersion() const
 {
-    if( _commands.empty( ))
-        return VERSION_INVALID;
+    return _received > 0 ? _pendingVersion : VERSION_INVALID;
+}
+
+void ObjectDataIStream::decode()
+{
+    LBASSERT( _decoding );
+    LBASSERT( isReady( ));
+    LBASSERT( _decoded.empty( ));
+
+    _decoded.resize( _commands.size( ));
+    for( size_t i = 0; i < _commands.size(); ++i )
+    {
+        ObjectDataICommand command( _commands[ i ] );
+        const uint32_t compressor = command.getCompressor();
+        const uint64_t dataSize = command.getDataSize();
+        if( compressor == EQ_COMPRESSOR_NONE || dataSize == 0 )
+            continue;
 
-    const ObjectDataICommand& cmd( _commands.back( ));
-    return cmd.getVersion();
+        lunchbox::Bufferb& buffer = _decoded[ i ];
+        buffer.reset( dataSize );
+        _decompress( _getChunkData( command ), compressor, command.getChunks(),
+                     dataSize, buffer.getData( ));
+    }
+    _decoding = false;
 }
 
-bool ObjectDataIStream::getNextBuffer( uint32_t& compressor, uint32_t& nChunks,
-                                       const void** chunkData, uint64_t& size )
+bool ObjectDataIStream::_popCommand()
 {
+    // In streaming mode the next command might not have arrived yet. No
+    // command follows the last one, which may be consumed before the stream
+    // becomes ready.
+    if( _lastConsumed )
+    {
+        _usedCommand.clear();
+        return false;
+    }
+    if( !isReady( ))
+        _received.waitGE( _consumed + 1 );
+
+    lunchbox::ScopedFastWrite mutex( _lock );
     if( _commands.empty( ))
     {
         _usedCommand.clear();
@@ -140,6 +218,26 @@ bool ObjectDataIStream::getNextBuffer( uint32_t& compressor, uint32_t& nChunks,
 
     _usedCommand = _commands.front();
     _commands.pop_front();
+    ++_consumed;
+    _lastConsumed = ObjectDataICommand( _usedCommand ).isLast();
+
+    if( _decoded.empty( ))
+        _usedBuffer.setSize( 0 );
+    else
+    {
+        _usedBuffer.swap( _decoded.front( ));
+        _decoded.pop_front();
+    }
+    return true;
+}
+
+bool ObjectDataIStream::getNextBuffer( uint32_t& compressor, uint32_t& nChunks,
+                                       const void** chunkData, uint64_t& size )
+{
+    _decoding.waitEQ( false );
+    if( !_popCommand( ))
+        return false;
+
     if( !_usedCommand.isValid( ))
         return false;
 
@@ -154,19 +252,19 @@ bool ObjectDataIStream::getNextBuffer( uint32_t& compressor, uint32_t& nChunks,
         return getNextBuffer( compressor, nChunks, chunkData, size );
 
     size = dataSize;
-    compressor = command.getCompressor();
-    nChunks = command.getChunks();
-    switch( command.getCommand( ))
+    if( _usedBuffer.isEmpty( ))
     {
-      case CMD_OBJECT_INSTANCE:
-        command.get< NodeID >();    // nodeID
-        command.get< uint32_t >();  // instanceID
-        break;
-      case CMD_OBJECT_SLAVE_DELTA:
-        command.get< UUID >();      // commit UUID
-        break;
+        compressor = command.getCompressor();
+        nChunks = command.getChunks();
+        *chunkData = _getChunkData( command );
+    }
+    else // decompressed by decode()
+    {
+        LBASSERT( _usedBuffer.getSize() == dataSize );
+        compressor = EQ_COMPRESSOR_NONE;
+        nChunks = 1;
+        *chunkData = _usedBuffer.getData();
     }
-    *chunkData = command.getRemainingBuffer( command.getRemainingBufferSize( ));
 
     setSwapping( command.isSwapping( ));
     return true;
@@ -22,14 +22,23 @@
 #include <co/iCommand.h>        // member
 #include <co/dataIStream.h>     // base class
 #include <co/version.h>         // enum
+#include <lunchbox/buffer.h>    // member
 #include <lunchbox/monitor.h>   // member
+#include <lunchbox/spinLock.h>  // member
 #include <lunchbox/thread.h>    // member
 
 #include <deque>
 
 namespace co
 {
-    /** The DataIStream for object data. */
+    /**
+     * The DataIStream for object data.
+     *
+     * Data commands are added by the receiver thread. The stream can be read
+     * once it is ready, or in streaming mode as soon as the first command has
+     * been added. In streaming mode, reading blocks until the next command of
+     * the version has arrived.
+     */
     class ObjectDataIStream : public DataIStream
     {
     public:
@@ -40,19 +49,35 @@ namespace co
         void addDataCommand( ObjectDataICommand command );
         size_t getDataSize() const;
 
-        virtual uint128_t getVersion() const { return _version.get(); }
+        /** @return the version, also while the stream is being received. */
+        virtual uint128_t getVersion() const;
         uint128_t getPendingVersion() const;
 
         void waitReady() const { _version.waitNE( VERSION_INVALID ); }
         bool isReady() const { return _version != VERSION_INVALID; }
 
-        virtual size_t nRemainingBuffers() const { return _commands.size(); }
+        /** Wait until the first command has been added to the stream. */
+        void waitStarted() const { _received.waitGE( 1 ); }
+
+        virtual size_t nRemainingBuffers() const;
 
         virtual void reset();
 
         bool hasInstanceData() const;
         CO_API virtual NodePtr getMaster();
 
+        /** @internal Mark the stream as queued for decode(). */
+        void setDecoding() { _decoding = true; }
+
+        /**
+         * @internal
+         * Decompress all data of this ready stream into read buffers.
+         *
+         * Called from the DecoderThread. Reading the stream blocks until the
+         * decoding has finished.
+         */
+        void decode();
+
     protected:
         virtual bool getNextBuffer( uint32_t& compressor, uint32_t& nChunks,
                                     const void** chunkData, uint64_t& size );
@@ -60,17 +85,36 @@ namespace co
     private:
         typedef std::deque< ICommand > CommandDeque;
 
-        /** All data commands for this istream. */        
+        /** All data commands for this istream. */
         CommandDeque _commands;
+        mutable lunchbox::SpinLock _lock; //!< protects _commands
 
         ICommand _usedCommand; //!< Currently used buffer
 
+        /** Decompressed data of the commands, empty if not decoded. */
+        std::deque< lunchbox::Bufferb > _decoded;
+        lunchbox::Bufferb _usedBuffer; //!< Decompressed data of _usedCommand
+
+        /** True while the stream is queued for decoding. */
+        lunchbox::Monitor< bool > _decoding;
+
+        /** The number of commands added and read from the stream. */
+        lunchbox::Monitor< uint32_t > _received;
+        uint32_t _consumed;
+        bool _lastConsumed; //!< The last command has been read
+
+        /** The version of the added commands. */
+        uint128_t _pendingVersion;
+
         /** The object version associated with this input stream. */
         lunchbox::Monitor< uint128_t > _version;
 
-        void _setReady() { _version = getPendingVersion(); }
+        void _setReady() { _version = _pendingVersion; }
         void _reset();
 
+        /** Pop the next command to read, blocking in streaming mode. */
+        bool _popCommand();
+
         LB_TS_VAR( _thread );
     };
 }
@@ -17,10 +17,22 @@
 
 #include "objectOCommand.h"
 
+#include "commandTrace.h"
+
+#include <lunchbox/buffer.h>
 
 namespace co
 {
 
+namespace
+{
+void _writeObjectHeader( DataOStream& os, const UUID& id,
+                         const uint32_t instanceID )
+{
+    os << id << instanceID;
+}
+}
+
 namespace detail
 {
 
@@ -59,7 +71,29 @@ ObjectOCommand::ObjectOCommand( const ObjectOCommand& rhs )
 
 void ObjectOCommand::_init( const UUID& id, const uint32_t instanceID )
 {
-    *this << id << instanceID;
+    _writeObjectHeader( *this, id, instanceID );
+}
+
+void ObjectOCommand::writeHeader( DataOStream& os, const uint32_t cmd,
+                                  const uint32_t type, const UUID& id,
+                                  const uint32_t instanceID )
+{
+    OCommand::writeHeader( os, cmd, type );
+    _writeObjectHeader( os, id, instanceID );
+}
+
+void ObjectOCommand::setInstanceID( lunchbox::Bufferb& command,
+                                    const uint32_t instanceID )
+{
+    // The instance follows the command header and the object identifier
+    uint32_t type;
+    ::memcpy( &type, command.getData() + sizeof( uint64_t ), sizeof( type ));
+    size_t pos = OCommand::getSize() + sizeof( UUID );
+    if( type & CommandTrace::COMMANDTYPE_TRACED )
+        pos += sizeof( int64_t );
+
+    LBASSERT( command.getSize() >= pos + sizeof( instanceID ));
+    ::memcpy( command.getData() + pos, &instanceID, sizeof( instanceID ));
 }
 
 ObjectOCommand::~ObjectOCommand()
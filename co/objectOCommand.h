@@ -67,6 +67,15 @@ public:
     /** Send or dispatch this command during destruction. */
     CO_API virtual ~ObjectOCommand();
 
+    /** @internal Write the header of an untraced object command. */
+    CO_API static void writeHeader( DataOStream& os, const uint32_t cmd,
+                                    const uint32_t type, const UUID& id,
+                                    const uint32_t instanceID );
+
+    /** @internal Change the instance of a serialized object command. */
+    CO_API static void setInstanceID( lunchbox::Bufferb& command,
+                                      const uint32_t instanceID );
+
 private:
     ObjectOCommand();
     ObjectOCommand& operator = ( const ObjectOCommand& );
@@ -22,8 +22,10 @@
 #include "barrier.h"
 #include "connection.h"
 #include "connectionDescription.h"
+#include "decoderThread.h"
 #include "global.h"
 #include "instanceCache.h"
+#include "instanceCacheFile.h"
 #include "log.h"
 #include "masterCMCommand.h"
 #include "nodeCommand.h"
@@ -51,6 +53,8 @@ ObjectStore::ObjectStore( LocalNode* localNode )
         , _instanceIDs( -0x7FFFFFFF )
         , _instanceCache( new InstanceCache( Global::getIAttribute(
                               Global::IATTR_INSTANCE_CACHE_SIZE ) * LB_1MB ) )
+        , _instanceCacheFile( 0 )
+        , _decoder( new DecoderThread )
 {
     LBASSERT( localNode );
     CommandQueue* queue = localNode->getCommandThreadQueue();
@@ -91,6 +95,10 @@ ObjectStore::ObjectStore( LocalNode* localNode )
         CmdFunc( this, &ObjectStore::_cmdRemoveNode ), queue );
     localNode->_registerCommand( CMD_NODE_OBJECT_PUSH,
         CmdFunc( this, &ObjectStore::_cmdObjectPush ), queue );
+    localNode->_registerCommand( CMD_NODE_FLUSH_MAX_VERSIONS,
+        CmdFunc( this, &ObjectStore::_cmdFlushMaxVersions ), queue );
+    localNode->_registerCommand( CMD_NODE_OBJECT_MAX_VERSIONS,
+        CmdFunc( this, &ObjectStore::_cmdObjectMaxVersions ), 0 );
 }
 
 ObjectStore::~ObjectStore()
@@ -124,6 +132,10 @@ ObjectStore::~ObjectStore()
    clear();
    delete _instanceCache;
    _instanceCache = 0;
+   delete _instanceCacheFile;
+   _instanceCacheFile = 0;
+   delete _decoder;
+   _decoder = 0;
 }
 
 void ObjectStore::clear( )
@@ -134,6 +146,8 @@ void ObjectStore::clear( )
 
     _objects->clear();
     _sendQueue.clear();
+    _acks->clear();
+    _decoder->stop();
 }
 
 void ObjectStore::disableInstanceCache()
@@ -143,6 +157,40 @@ void ObjectStore::disableInstanceCache()
     _instanceCache = 0;
 }
 
+bool ObjectStore::enableInstanceCacheFile( const std::string& filename )
+{
+    LBASSERT( _localNode->isClosed( ));
+    if( !_instanceCache )
+        return false;
+
+    if( !_instanceCacheFile )
+        _instanceCacheFile = new InstanceCacheFile;
+    else
+        _instanceCacheFile->close();
+
+    const uint64_t size = uint64_t( Global::getIAttribute(
+                              Global::IATTR_INSTANCE_CACHE_FILE_SIZE )) * LB_1MB;
+    if( _instanceCacheFile->open( filename, size ))
+        return true;
+
+    delete _instanceCacheFile;
+    _instanceCacheFile = 0;
+    return false;
+}
+
+void ObjectStore::decode( ObjectDataIStream* stream )
+{
+    LB_TS_THREAD( _receiverThread );
+    _decoder->decode( stream );
+}
+
+InstanceCacheStats ObjectStore::getInstanceCacheStats() const
+{
+    if( _instanceCache )
+        return _instanceCache->getStats();
+    return InstanceCacheStats();
+}
+
 void ObjectStore::expireInstanceData( const int64_t age )
 {
     if( _instanceCache )
@@ -395,7 +443,14 @@ uint32_t ObjectStore::mapObjectNB( Object* object, const UUID& id,
 
     if( _instanceCache )
     {
-        const InstanceCache::Data& cached = (*_instanceCache)[ id ];
+        const InstanceCache::Data* data = &(*_instanceCache)[ id ];
+        if( *data == InstanceCache::Data::NONE && _instanceCacheFile &&
+            _instanceCacheFile->load( id, master, _localNode, *_instanceCache ))
+        {
+            data = &(*_instanceCache)[ id ];
+        }
+
+        const InstanceCache::Data& cached = *data;
         if( cached != InstanceCache::Data::NONE )
         {
             const ObjectDataIStreamDeque& versions = cached.versions;
@@ -581,6 +636,61 @@ void ObjectStore::removeNode( NodePtr node )
     _localNode->waitRequest( requestID );
 }
 
+void ObjectStore::ackMaxVersion( NodePtr master, const UUID& id,
+                                 const uint32_t masterInstanceID,
+                                 const uint64_t maxVersion,
+                                 const uint32_t slaveInstanceID )
+{
+    const MaxVersionAcks::Key key( id, slaveInstanceID );
+    bool flush = false;
+    {
+        lunchbox::ScopedFastWrite mutex( _acks );
+        flush = _acks->empty();
+
+        MaxVersionAcksHash::iterator i = _acks->find( master->getNodeID( ));
+        if( i != _acks->end( ))
+        {
+            MaxVersionAck& ack = i->second.acks[ key ];
+            ack.masterInstanceID = masterInstanceID;
+            ack.maxVersion = LB_MAX( ack.maxVersion, maxVersion );
+            return;
+        }
+
+        // open the window for coalescing further acks to this master
+        _acks.data[ master->getNodeID() ].node = master;
+    }
+
+    // The first ack to a master is sent directly. Later acks are queued and
+    // sent together once the command thread runs the flush scheduled here.
+    MaxVersionAcks acks;
+    acks.node = master;
+    MaxVersionAck& ack = acks.acks[ key ];
+    ack.masterInstanceID = masterInstanceID;
+    ack.maxVersion = maxVersion;
+    _sendMaxVersions( acks );
+
+    if( flush )
+        _localNode->send( CMD_NODE_FLUSH_MAX_VERSIONS );
+}
+
+void ObjectStore::_sendMaxVersions( const MaxVersionAcks& acks )
+{
+    NodePtr master = acks.node;
+    if( acks.acks.empty() || !master->isReachable( ))
+        return;
+
+    OCommand command( master->send( CMD_NODE_OBJECT_MAX_VERSIONS ));
+    command << uint64_t( acks.acks.size( ));
+
+    for( MaxVersionAcks::MapCIter i = acks.acks.begin(); i != acks.acks.end();
+         ++i )
+    {
+        const MaxVersionAck& ack = i->second;
+        command << i->first.first << ack.masterInstanceID << ack.maxVersion
+                << i->first.second;
+    }
+}
+
 //===========================================================================
 // ICommand handling
 //===========================================================================
@@ -628,6 +738,55 @@ bool ObjectStore::dispatchObjectCommand( ICommand& cmd )
     return true;
 }
 
+bool ObjectStore::isUnordered( const UUID& id, const uint32_t instanceID,
+                               const uint32_t cmd )
+{
+    lunchbox::ScopedFastRead mutex( _objects );
+    return _findUnordered( id, instanceID, cmd ) != 0;
+}
+
+bool ObjectStore::dispatchCommand( ICommand& cmd )
+{
+    ObjectICommand command( cmd );
+    lunchbox::ScopedFastRead mutex( _objects );
+    Object* object = _findUnordered( command.getObjectID(),
+                                     command.getInstanceID(),
+                                     command.getCommand( ));
+    if( !object )
+    {
+        LBWARN << "Object of local " << command << " is gone" << std::endl;
+        return false;
+    }
+    return object->dispatchCommand( command );
+}
+
+Object* ObjectStore::_findUnordered( const UUID& id, const uint32_t instanceID,
+                                     const uint32_t cmd ) const
+{
+    ObjectsHashCIter i = _objects->find( id );
+    if( i == _objects->end( ))
+        return 0;
+
+    const Objects& objects = i->second;
+    Object* result = 0;
+    for( ObjectsCIter j = objects.begin(); j != objects.end(); ++j )
+    {
+        Object* object = *j;
+        if( instanceID <= EQ_INSTANCE_MAX &&
+            instanceID != object->getInstanceID( ))
+        {
+            continue;
+        }
+        if( result ) // more than one receiver
+            return 0;
+        result = object;
+    }
+
+    if( result && result->isUnordered( cmd ))
+        return result;
+    return 0;
+}
+
 bool ObjectStore::_cmdFindMasterNodeID( ICommand& command )
 {
     LB_TS_THREAD( _commandThread );
@@ -996,7 +1155,11 @@ bool ObjectStore::_cmdInstance( ICommand& inCommand )
 #ifndef CO_AGGRESSIVE_CACHING // Issue #82:
         if( cmd != CMD_NODE_OBJECT_INSTANCE_PUSH )
 #endif
+        {
             _instanceCache->add( rev, masterInstanceID, command, 0 );
+            if( _instanceCacheFile )
+                _instanceCacheFile->add( rev, masterInstanceID, command );
+        }
     }
 
     switch( cmd )
@@ -1094,6 +1257,58 @@ bool ObjectStore::_cmdObjectPush( ICommand& command )
     return true;
 }
 
+bool ObjectStore::_cmdFlushMaxVersions( ICommand& )
+{
+    LB_TS_THREAD( _commandThread );
+
+    MaxVersionAcksHash acksHash;
+    {
+        lunchbox::ScopedFastWrite mutex( _acks );
+        _acks->swap( acksHash );
+    }
+
+    // closes the coalescing window of all masters
+    for( MaxVersionAcksHashCIter i = acksHash.begin(); i != acksHash.end();
+         ++i )
+    {
+        _sendMaxVersions( i->second );
+    }
+    return true;
+}
+
+bool ObjectStore::_cmdObjectMaxVersions( ICommand& command )
+{
+    LB_TS_THREAD( _receiverThread );
+
+    NodePtr node = command.getNode();
+    const uint64_t nAcks = command.get< uint64_t >();
+
+    for( uint64_t i = 0; i < nAcks; ++i )
+    {
+        const UUID& id = command.get< UUID >();
+        const uint32_t masterInstanceID = command.get< uint32_t >();
+        const uint64_t maxVersion = command.get< uint64_t >();
+        const uint32_t slaveInstanceID = command.get< uint32_t >();
+
+        ObjectsHashCIter j = _objects->find( id );
+        if( j == _objects->end( ))
+            continue; // master deregistered meanwhile
+
+        const Objects& objects = j->second;
+        for( ObjectsCIter k = objects.begin(); k != objects.end(); ++k )
+        {
+            Object* object = *k;
+            if( object->getInstanceID() == masterInstanceID )
+            {
+                object->setSlaveMaxVersion( node, slaveInstanceID,
+                                            maxVersion );
+                break;
+            }
+        }
+    }
+    return true;
+}
+
 std::ostream& operator << ( std::ostream& os, ObjectStore* objectStore )
 {
     if( !objectStore )
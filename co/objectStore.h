@@ -27,11 +27,15 @@
 #include <lunchbox/spinLock.h>  // member
 #include <lunchbox/stdExt.h>    // member
 
+#include <map>                  // member
+
 #include "dataIStreamQueue.h"  // member
 
 namespace co
 {
+    class DecoderThread;
     class InstanceCache;
+    class InstanceCacheFile;
 
     /** An object store manages Object mapping for a LocalNode. */
     class ObjectStore : public Dispatcher
@@ -139,6 +143,29 @@ namespace co
         /** Disable the instance cache of an stopped local node. */
         void disableInstanceCache();
 
+        /** @return the statistics of the instance cache. */
+        InstanceCacheStats getInstanceCacheStats() const;
+
+        /** Keep instance data persistently in the given file. */
+        bool enableInstanceCacheFile( const std::string& filename );
+
+        /**
+         * @return true if the only local instance of the object handles the
+         *         command unordered in a command queue. Thread-safe.
+         */
+        bool isUnordered( const UUID& id, const uint32_t instanceID,
+                          const uint32_t cmd );
+
+        /**
+         * Dispatch a local object command from any thread, bypassing the self
+         * connection. The object is resolved and the command queued while the
+         * object can't be deregistered.
+         */
+        virtual bool dispatchCommand( ICommand& command );
+
+        /** Decompress a ready slave data stream in the decoder thread. */
+        void decode( ObjectDataIStream* stream );
+
         /** Enable sending data of newly registered objects when idle. */
         void enableSendOnRegister();
 
@@ -164,6 +191,21 @@ namespace co
          * Remove a slave node in all objects
          */
         void removeNode( NodePtr node );
+
+        /**
+         * @internal
+         * Queue a max version acknowledgement of a slave object.
+         *
+         * The first acknowledgement to a master node is sent directly. Further
+         * ones are aggregated per master node and sent as one command when
+         * the command thread processes the flush scheduled by the first. A
+         * newer acknowledgement for the same slave instance replaces the
+         * queued one.
+         */
+        void ackMaxVersion( NodePtr master, const UUID& id,
+                            const uint32_t masterInstanceID,
+                            const uint64_t maxVersion,
+                            const uint32_t slaveInstanceID );
         //@}
 
     private:
@@ -186,6 +228,10 @@ namespace co
          */
         lunchbox::Lockable< ObjectsHash, lunchbox::SpinLock > _objects;
 
+        /** @return the single unordered receiver of a command, _objects locked */
+        Object* _findUnordered( const UUID& id, const uint32_t instanceID,
+                                const uint32_t cmd ) const;
+
         struct SendQueueItem
         {
             int64_t age;
@@ -196,8 +242,36 @@ namespace co
 
         SendQueue _sendQueue;          //!< Object data to broadcast when idle
         InstanceCache* _instanceCache; //!< cached object mapping data
+        InstanceCacheFile* _instanceCacheFile; //!< persistent mapping data
+        DecoderThread* _decoder;       //!< prefetch decompression of slaves
         DataIStreamQueue _pushData;    //!< Object::push() queue
 
+        struct MaxVersionAck
+        {
+            MaxVersionAck() : masterInstanceID( EQ_INSTANCE_INVALID )
+                            , maxVersion( 0 ) {}
+
+            uint32_t masterInstanceID;
+            uint64_t maxVersion;
+        };
+
+        /** Pending acks of one master node, by object and slave instance. */
+        struct MaxVersionAcks
+        {
+            typedef std::pair< UUID, uint32_t > Key;
+            typedef std::map< Key, MaxVersionAck > Map;
+            typedef Map::const_iterator MapCIter;
+
+            NodePtr node;
+            Map acks;
+        };
+
+        typedef stde::hash_map< NodeID, MaxVersionAcks > MaxVersionAcksHash;
+        typedef MaxVersionAcksHash::const_iterator MaxVersionAcksHashCIter;
+
+        /** Max version acks not yet sent, by master node. */
+        lunchbox::Lockable< MaxVersionAcksHash, lunchbox::SpinLock > _acks;
+
         /**
          * Returns the master node id for an identifier.
          *
@@ -229,6 +303,10 @@ namespace co
         bool _cmdDisableSendOnRegister( ICommand& command );
         bool _cmdRemoveNode( ICommand& command );
         bool _cmdObjectPush( ICommand& command );
+        bool _cmdFlushMaxVersions( ICommand& command );
+        bool _cmdObjectMaxVersions( ICommand& command );
+
+        void _sendMaxVersions( const MaxVersionAcks& acks );
 
         LB_TS_VAR( _receiverThread );
         LB_TS_VAR( _commandThread );
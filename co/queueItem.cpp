@@ -17,11 +17,26 @@
 
 #include "queueItem.h"
 
+#include "objectOCommand.h"
+#include "queueCommand.h"
 #include "queueMaster.h"
 
 
 namespace co
 {
+namespace
+{
+/**
+ * Write the ObjectOCommand header of the item, completed by the QueueMaster.
+ * The slave dispatches items sliced from a batch without copying them.
+ */
+void _writeHeader( co::QueueItem& item, const co::QueueMaster& master )
+{
+    ObjectOCommand::writeHeader( item, CMD_QUEUE_ITEM, COMMANDTYPE_OBJECT,
+                                 master.getID(), EQ_INSTANCE_NONE );
+}
+}
+
 namespace detail
 {
 class QueueItem
@@ -45,6 +60,7 @@ QueueItem::QueueItem( QueueMaster& master )
 {
     enableSave();
     _enable();
+    _writeHeader( *this, _impl->queueMaster );
 }
 
 QueueItem::QueueItem( const QueueItem& rhs )
@@ -53,6 +69,7 @@ QueueItem::QueueItem( const QueueItem& rhs )
 {
     enableSave();
     _enable();
+    _writeHeader( *this, _impl->queueMaster );
 }
 
 QueueItem::~QueueItem()
@@ -19,6 +19,7 @@
 
 #include "queueMaster.h"
 
+#include "connection.h"
 #include "dataOStream.h"
 #include "objectICommand.h"
 #include "objectOCommand.h"
@@ -36,10 +37,13 @@ namespace detail
 class ItemBuffer : public lunchbox::Bufferb, public lunchbox::Referenced
 {
 public:
+    /** Takes over the data of the given buffer. */
     ItemBuffer( lunchbox::Bufferb& from )
-        : lunchbox::Bufferb( from )
+        : lunchbox::Bufferb()
         , lunchbox::Referenced()
-    {}
+    {
+        swap( from );
+    }
 
     ~ItemBuffer()
     {}
@@ -63,21 +67,38 @@ public:
         const uint32_t itemsRequested = command.get< uint32_t >();
         const uint32_t slaveInstanceID = command.get< uint32_t >();
         const int32_t requestID = command.get< int32_t >();
+        const int64_t requestTime = command.get< int64_t >();
 
         typedef std::vector< ItemBufferPtr > Items;
         Items items;
         queue.tryPop( itemsRequested, items );
 
-        Connections connections( 1, command.getNode()->getConnection( ));
-        for( Items::const_iterator i = items.begin(); i != items.end(); ++i )
+        ConnectionPtr connection = command.getNode()->getConnection();
+        Connections connections( 1, connection );
+        if( !items.empty( ))
         {
-            co::ObjectOCommand cmd( connections, CMD_QUEUE_ITEM,
+            // Send all items in one command, sliced by the slave. Each item
+            // buffer holds its own command header and is sent without a copy.
+            uint64_t size = 0;
+            for( Items::const_iterator i = items.begin(); i != items.end();
+                 ++i )
+            {
+                const ItemBufferPtr item = *i;
+                ObjectOCommand::setInstanceID( *item, slaveInstanceID );
+                size += item->getSize();
+            }
+
+            co::ObjectOCommand cmd( connections, CMD_QUEUE_ITEMS,
                                     COMMANDTYPE_OBJECT, _parent.getID(),
                                     slaveInstanceID );
-
-            const ItemBufferPtr item = *i;
-            if( !item->isEmpty( ))
-                cmd << Array< const void >( item->getData(), item->getSize( ));
+            cmd << requestTime << uint32_t( items.size( ));
+            cmd.sendHeader( size );
+            for( Items::const_iterator i = items.begin(); i != items.end();
+                 ++i )
+            {
+                const ItemBufferPtr item = *i;
+                connection->send( item->getData(), item->getSize(), true );
+            }
         }
 
         if( itemsRequested > items.size( ))
@@ -114,10 +135,11 @@ void QueueMaster::attach( const UUID& id, const uint32_t instanceID )
 {
     Object::attach( id, instanceID );
 
-    CommandQueue* queue = getLocalNode()->getCommandThreadQueue();
+    CommandQueue* queue = getLocalNode()->getCommandThreadQueue( id );
     registerCommand( CMD_QUEUE_GET_ITEM,
                      CommandFunc< detail::QueueMaster >(
                          _impl, &detail::QueueMaster::cmdGetItem ), queue );
+    setUnordered( CMD_QUEUE_GET_ITEM ); // requests are independent
 }
 
 void QueueMaster::clear()
@@ -138,6 +160,8 @@ QueueItem QueueMaster::push()
 void QueueMaster::_addItem( QueueItem& item )
 {
     detail::ItemBufferPtr newBuffer = new detail::ItemBuffer( item.getBuffer());
+    reinterpret_cast< uint64_t* >( newBuffer->getData( ))[ 0 ] =
+        newBuffer->getSize();
     _impl->queue.push( newBuffer );
 }
 
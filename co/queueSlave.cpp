@@ -27,32 +27,132 @@
 #include "objectICommand.h"
 #include "queueCommand.h"
 
+#include <lunchbox/clock.h>
+#include <lunchbox/scopedMutex.h>
+
 namespace co
 {
 namespace detail
 {
-class QueueSlave
+namespace
+{
+static const uint32_t _maxPrefetch = 1024; // upper limit of adaptive prefetch
+}
+
+class QueueSlave : public co::Dispatcher
 {
 public:
-    QueueSlave( const uint32_t mark, const uint32_t amount)
-            : prefetchMark( mark )
-            , prefetchAmount( amount )
+    QueueSlave( co::QueueSlave& parent, const uint32_t mark_,
+                const uint32_t amount_ )
+            : co::Dispatcher()
+            , prefetchMark( mark_ )
+            , prefetchAmount( amount_ )
             , masterInstanceID( EQ_INSTANCE_ALL )
+            , adaptive( Global::getIAttribute( Global::IATTR_QUEUE_ADAPTIVE ) != 0 )
+            , mark( mark_ )
+            , amount( amount_ )
+            , processTime( 0. )
+            , lastPop( -1 )
+            , rtt( 0 )
+            , requested( 0 )
+            , _parent( parent )
         {}
 
+    /** Slice a batch into single item commands, receiver thread. */
+    bool cmdItems( co::ICommand& comd )
+    {
+        co::ObjectICommand command( comd );
+        ConstBufferPtr buffer = command.getBuffer();
+        const int64_t requestTime = command.get< int64_t >();
+        const uint32_t nItems = command.get< uint32_t >();
+
+        rtt = int32_t( getTime() - requestTime );
+        requested = 0;
+
+        // Each item is a complete command sharing the buffer of the batch
+        for( uint32_t i = 0; i < nItems; ++i )
+        {
+            const uint64_t size = command.get< uint64_t >();
+            const uint8_t* data = static_cast< const uint8_t* >(
+                command.getRemainingBuffer( size - sizeof( size )));
+            const uint64_t offset = data - sizeof( size ) - buffer->getData();
+
+            co::ICommand item( command.getLocalNode(), command.getNode(),
+                               buffer, offset, size, command.isSwapping( ));
+            _parent.dispatchCommand( item );
+        }
+        return true;
+    }
+
+    /** Start timing the processing of a popped item, application thread. */
+    void startPop()
+    {
+        const int64_t now = getTime();
+        if( lastPop >= 0 ) // moving average of the item processing time
+            processTime = processTime > 0. ?
+                              .875 * processTime + .125 * double( now-lastPop ):
+                              double( now - lastPop );
+    }
+
+    /** Item popped, application thread. */
+    void endPop() { lastPop = getTime(); }
+
+    /** @return the time since the creation of this slave in microseconds. */
+    int64_t getTime() const { return int64_t( clock.getTimed() * 1000. ); }
+
+    /**
+     * Update the prefetch mark and amount to keep the items consumed during
+     * one round trip to the master in flight.
+     */
+    void update()
+    {
+        if( !adaptive || rtt <= 0 || processTime <= 0. )
+            return;
+
+        const uint32_t target = LB_MIN( uint32_t( double( rtt ) / processTime )
+                                        + 1, _maxPrefetch );
+        mark = LB_MAX( target, prefetchMark );
+        amount = LB_MAX( target, prefetchAmount );
+    }
+
+    /** @return true if new items shall be requested. */
+    bool needsItems() const
+    {
+        if( queue.getSize() > mark )
+            return false;
+        // only one request in flight, its items are on their way
+        return !adaptive || requested == 0;
+    }
+
     co::CommandQueue queue;
+    lunchbox::Lock popLock; //!< serializes pop() of several threads
 
     const uint32_t prefetchMark;
     const uint32_t prefetchAmount;
     uint32_t masterInstanceID;
 
     NodePtr master;
+
+    const bool adaptive; //!< adapt mark and amount to the consume rate
+    uint32_t mark;       //!< current low-water mark
+    uint32_t amount;     //!< current refill quantity
+    lunchbox::Clock clock;
+    double processTime;  //!< average item processing time in us
+    int64_t lastPop;     //!< time of the last returned pop in us
+    lunchbox::a_int32_t rtt; //!< last round trip time to the master in us
+    lunchbox::a_int32_t requested; //!< number of requests in flight
+
+private:
+    co::QueueSlave& _parent;
 };
 }
 
 QueueSlave::QueueSlave( const uint32_t prefetchMark,
                         const uint32_t prefetchAmount )
-        : _impl( new detail::QueueSlave( prefetchMark, prefetchAmount ))
+#pragma warning(push)
+#pragma warning(disable: 4355)
+        : _impl( new detail::QueueSlave( *this, prefetchMark, prefetchAmount ))
+#pragma warning(pop)
 {}
 
 QueueSlave::~QueueSlave()
@@ -65,6 +165,9 @@ void QueueSlave::attach( const UUID& id, const uint32_t instanceID )
     Object::attach(id, instanceID);
     registerCommand( CMD_QUEUE_ITEM, CommandFunc<Object>(0, 0), &_impl->queue );
     registerCommand( CMD_QUEUE_EMPTY, CommandFunc<Object>(0, 0), &_impl->queue);
+    registerCommand( CMD_QUEUE_ITEMS,
+                     CommandFunc< detail::QueueSlave >(
+                         _impl, &detail::QueueSlave::cmdItems ), 0 );
 }
 
 void QueueSlave::applyInstanceData( co::DataIStream& is )
@@ -83,26 +186,39 @@ ObjectICommand QueueSlave::pop()
     static lunchbox::a_int32_t _request;
     const int32_t request = ++_request;
 
+    // The item queue has a single consumer, application threads take turns
+    lunchbox::ScopedMutex<> mutex( _impl->popLock );
+    LB_TS_RESET( _impl->queue._thread );
+
+    _impl->startPop();
+    _impl->update();
+
     while( true )
     {
-        const size_t queueSize = _impl->queue.getSize();
-        if( queueSize <= _impl->prefetchMark )
+        if( _impl->needsItems( ))
         {
+            ++_impl->requested;
             send( _impl->master, CMD_QUEUE_GET_ITEM, _impl->masterInstanceID )
-                    << _impl->prefetchAmount << getInstanceID() << request;
+                    << _impl->amount << getInstanceID() << request
+                    << _impl->getTime();
         }
 
         ObjectICommand cmd( _impl->queue.pop( ));
         switch( cmd.getCommand( ))
         {
           case CMD_QUEUE_ITEM:
+              _impl->endPop();
               return ObjectICommand( cmd );
 
           default:
               LBUNIMPLEMENTED;
           case CMD_QUEUE_EMPTY:
+              _impl->requested = 0;
               if( cmd.get< int32_t >() == request )
+              {
+                  _impl->endPop();
                   return ObjectICommand( 0, 0, 0, false );
+              }
               // else left-over or not our empty command, discard and retry
               break;
         }
@@ -48,8 +48,13 @@ public:
      * the processing but may introduce imbalance between queue slaves if used
      * aggressively.
      *
-     * @param prefetchMark the low-water mark for prefetching.
-     * @param prefetchAmount the refill quantity when prefetching.
+     * If Global::IATTR_QUEUE_ADAPTIVE is enabled, the mark and amount
+     * are increased at runtime to the number of items processed during one
+     * round trip to the master, and only one request is in flight at a time.
+     * The given values are the minimum in this case.
+     *
+     * @param prefetchMark the (minimum) low-water mark for prefetching.
+     * @param prefetchAmount the (minimum) refill quantity when prefetching.
      * @version 1.0
      */
     CO_API QueueSlave( const uint32_t prefetchMark = 
@@ -64,7 +69,7 @@ public:
      * Dequeue an item.
      *
      * The returned item can deserialize additional data using the DataIStream
-     * operators.
+     * operators. Several threads may pop concurrently.
      *
      * @return an item from the distributed queue, or an invalid item if the
      *         queue is empty.
@@ -24,16 +24,29 @@
 #include "global.h"
 #include "log.h"
 
+#include <lunchbox/debug.h>
 #include <lunchbox/rng.h>
 #include <lunchbox/scopedMutex.h>
 #include <lunchbox/sleep.h>
 
 #include <boost/bind.hpp>
+#include <boost/version.hpp>
 
 //#define EQ_INSTRUMENT_RSP
 #define EQ_RSP_MERGE_WRITES
 #define EQ_RSP_MAX_TIMEOUTS 2000
 
+#ifdef __linux__
+// Send and receive bursts of datagrams using one sendmmsg/recvmmsg call
+#  define EQ_RSP_BATCHED_IO
+#  define EQ_RSP_BATCH_SIZE 32
+#  include <cerrno>
+#  include <cstring>
+#  include <sys/socket.h>
+#else
+#  define EQ_RSP_BATCH_SIZE 1
+#endif
+
 // Note: Do not use version > 255, endianness detection magic relies on this.
 const uint16_t EQ_RSP_PROTOCOL_VERSION = 0;
 
@@ -65,6 +78,17 @@ lunchbox::Clock instrumentClock;
 #endif
 
 static uint16_t _numBuffers = 0;
+
+#ifdef EQ_RSP_BATCHED_IO
+int _getFD( boost::asio::ip::udp::socket& socket )
+{
+#  if BOOST_VERSION >= 104700
+    return socket.native_handle();
+#  else
+    return socket.native();
+#  endif
+}
+#endif
 }
 
 RSPConnection::RSPConnection()
@@ -117,6 +141,11 @@ RSPConnection::~RSPConnection()
         delete _buffers.back();
         _buffers.pop_back();
     }
+    while( !_recvBatch.empty( ))
+    {
+        delete _recvBatch.back();
+        _recvBatch.pop_back();
+    }
 }
 
 void RSPConnection::_close()
@@ -558,10 +587,26 @@ void RSPConnection::_processOutgoing()
 }
 
 void RSPConnection::_writeData()
+{
+    size_t nWritten = 0;
+    while( nWritten < EQ_RSP_BATCH_SIZE && _writeDatagram( ))
+        ++nWritten;
+    _flushSends();
+
+    // Data to myself is 'written' only after it has been sent, since the
+    // buffers are released to the application
+    if( nWritten > 0 && _children.size() == 1 ) // We're all alone
+    {
+        LBASSERT( _children.front()->_id == _id );
+        _finishWriteQueue( _sequence - 1 );
+    }
+}
+
+bool RSPConnection::_writeDatagram()
 {
     Buffer* buffer = 0;
     if( !_threadBuffers.pop( buffer )) // nothing to write
-        return;
+        return false;
 
     _timeouts = 0;
     LBASSERT( buffer );
@@ -608,22 +653,73 @@ void RSPConnection::_writeData()
     const uint32_t size = header->size + sizeof( DatagramData );
 
     _waitWritable( size ); // OPT: process incoming in between
-    header->byteswap();
-    _write->send( boost::asio::buffer( header, size ));
-
 #ifdef EQ_INSTRUMENT_RSP
     ++nDatagrams;
     nBytesWritten += header->size;
 #endif
+    header->byteswap();
+    _send( header, size );
 
     // save datagram for repeats (and self)
     _writeBuffers.push_back( buffer );
+    return true;
+}
+
+void RSPConnection::_send( const void* data, const uint32_t size )
+{
+#ifdef EQ_RSP_BATCHED_IO
+    const Datagram datagram = { data, size };
+    _sendQueue.push_back( datagram );
+    if( _sendQueue.size() >= EQ_RSP_BATCH_SIZE )
+        _flushSends();
+#else
+    _write->send( boost::asio::buffer( data, size ));
+#endif
+}
+
+void RSPConnection::_flushSends()
+{
+#ifdef EQ_RSP_BATCHED_IO
+    const size_t nDatagrams = _sendQueue.size();
+    if( nDatagrams == 0 )
+        return;
 
-    if( _children.size() == 1 ) // We're all alone
+    mmsghdr messages[ EQ_RSP_BATCH_SIZE ];
+    iovec vectors[ EQ_RSP_BATCH_SIZE ];
+    ::memset( messages, 0, sizeof( messages ));
+    for( size_t i = 0; i < nDatagrams; ++i )
     {
-        LBASSERT( _children.front()->_id == _id );
-        _finishWriteQueue( _sequence - 1 );
+        vectors[i].iov_base = const_cast< void* >( _sendQueue[i].data );
+        vectors[i].iov_len = _sendQueue[i].size;
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // The socket is connected to the multicast group, no address needed
+    const int fd = _getFD( *_write );
+    size_t nSent = 0;
+    while( nSent < nDatagrams )
+    {
+        const int result = ::sendmmsg( fd, messages + nSent,
+                                       unsigned( nDatagrams - nSent ), 0 );
+        if( result < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            if( errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS )
+            {
+                // socket buffer full, retry once the kernel sent some data
+                lunchbox::Thread::yield();
+                continue;
+            }
+            // lost datagrams are repeated upon the receivers' nacks
+            LBWARN << "sendmmsg failed: " << lunchbox::sysError << std::endl;
+            break;
+        }
+        nSent += result;
     }
+    _sendQueue.clear();
+#endif
 }
 
 void RSPConnection::_waitWritable( const uint64_t bytes )
@@ -637,6 +733,10 @@ void RSPConnection::_waitWritable( const uint64_t bytes )
     _bucketSize = LB_MIN( _bucketSize, _maxBucketSize );
 
     const uint64_t size = LB_MIN( bytes, static_cast< uint64_t >( _mtu ));
+    if( _bucketSize < size )
+        // Queued datagrams are charged already, send them before waiting
+        _flushSends();
+
     while( _bucketSize < size )
     {
         lunchbox::Thread::yield();
@@ -672,7 +772,8 @@ void RSPConnection::_repeatData()
 {
     _timeouts = 0;
 
-    while( !_repeatQueue.empty( ))
+    size_t nSent = 0;
+    while( !_repeatQueue.empty() && nSent < EQ_RSP_BATCH_SIZE )
     {
         Nack& request = _repeatQueue.front();
         const uint16_t distance = _sequence - request.start;
@@ -695,7 +796,8 @@ void RSPConnection::_repeatData()
             // send data
             _waitWritable( size ); // OPT: process incoming in between
             // already done by _writeData: header->byteswap();
-            _write->send( boost::asio::buffer( header, size ) );
+            _send( header, size );
+            ++nSent;
 #ifdef EQ_INSTRUMENT_RSP
             ++nRepeated;
 #endif
@@ -705,10 +807,8 @@ void RSPConnection::_repeatData()
             _repeatQueue.pop_front();    // done with request
         else
             ++request.start;
-
-        if( distance <= _writeBuffers.size( )) // send something
-            return;
     }
+    _flushSends();
 }
 
 void RSPConnection::_finishWriteQueue( const uint16_t sequence )
@@ -797,6 +897,7 @@ void RSPConnection::_handlePacket( const boost::system::error_code& /* error */,
     if( isListening( ))
     {
         _handleConnectedData( bytes );
+        _readBatch();
 
         if( isListening( ))
             _processOutgoing();
@@ -946,6 +1047,36 @@ void RSPConnection::_asyncReceiveFrom()
                      placeholders::bytes_transferred ));
 }
 
+void RSPConnection::_readBatch()
+{
+#ifdef EQ_RSP_BATCHED_IO
+    // OPT: drain already received datagrams without a completion each
+    while( _recvBatch.size() < EQ_RSP_BATCH_SIZE )
+        _recvBatch.push_back( new Buffer( _mtu ));
+
+    mmsghdr messages[ EQ_RSP_BATCH_SIZE ];
+    iovec vectors[ EQ_RSP_BATCH_SIZE ];
+    ::memset( messages, 0, sizeof( messages ));
+    for( size_t i = 0; i < EQ_RSP_BATCH_SIZE; ++i )
+    {
+        vectors[i].iov_base = _recvBatch[i]->getData();
+        vectors[i].iov_len = _mtu;
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int nDatagrams = ::recvmmsg( _getFD( *_read ), messages,
+                                       EQ_RSP_BATCH_SIZE, MSG_DONTWAIT, 0 );
+    // The handlers use _recvBuffer, which may be swapped into a data buffer
+    for( int i = 0; i < nDatagrams && isListening(); ++i )
+    {
+        _recvBuffer.swap( *_recvBatch[i] );
+        _handleConnectedData( messages[i].msg_len );
+        _recvBuffer.swap( *_recvBatch[i] );
+    }
+#endif
+}
+
 bool RSPConnection::_handleData( const size_t bytes )
 {
     if( bytes < sizeof( DatagramData ))
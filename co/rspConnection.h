@@ -280,6 +280,14 @@ namespace co
 
         Buffer _recvBuffer;                      //!< Receive (thread) buffer
         std::deque< Buffer* > _recvBuffers;      //!< out-of-order buffers
+        Buffers _recvBatch;                      //!< Batched receive buffers
+
+        struct Datagram
+        {
+            const void* data;
+            uint32_t size;
+        };
+        std::vector< Datagram > _sendQueue; //!< Datagrams to send in one batch
 
         Buffer* _readBuffer;                     //!< Read (app) buffer
         uint64_t _readBufferPos;                 //!< Current read index
@@ -295,6 +303,7 @@ namespace co
 
         void _processOutgoing();
         void _writeData();
+        bool _writeDatagram();
         void _repeatData();
         void _finishWriteQueue( const uint16_t sequence );
 
@@ -329,9 +338,21 @@ namespace co
         /** find the connection corresponding to the identifier */
         RSPConnectionPtr _findConnection( const uint16_t id );
 
-        /** Sleep until allowed to send according to send rate */
+        /**
+         * Sleep until allowed to send according to send rate. Batched
+         * datagrams are flushed before sleeping.
+         */
         void _waitWritable( const uint64_t bytes );
 
+        /** Send a datagram, possibly batched until _flushSends(). */
+        void _send( const void* data, const uint32_t size );
+
+        /** Send all batched datagrams. */
+        void _flushSends();
+
+        /** Handle the datagrams already received without blocking. */
+        void _readBatch();
+
         /** format and send a datagram count node */
         void _sendCountNode();
 
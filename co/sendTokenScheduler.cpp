@@ -0,0 +1,203 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "sendTokenScheduler.h"
+
+#include "global.h"
+#include "node.h"
+
+#include <lunchbox/debug.h>
+
+namespace co
+{
+namespace
+{
+static const uint64_t _stride = 1 << 16;
+}
+
+SendTokenScheduler::SendTokenScheduler()
+    : _maxTokens( 1 )
+    , _available( 1 )
+    , _lastTime( 0 )
+    , _pass( 0 )
+{}
+
+void SendTokenScheduler::setMaxTokens( const uint32_t maxTokens )
+{
+    const uint32_t used = _maxTokens - _available;
+    _maxTokens = LB_MAX( maxTokens, 1u );
+    _available = used < _maxTokens ? _maxTokens - used : 0;
+}
+
+void SendTokenScheduler::request( NodePtr node, const uint32_t requestID,
+                                  const uint32_t weight, const uint64_t time,
+                                  Grants& grants )
+{
+    if( _available == 0 )
+    {
+        const uint32_t timeout = Global::getTimeout();
+        if( timeout != LB_TIMEOUT_INDEFINITE && time - _lastTime > timeout )
+        {
+            // timeout! - reclaim all tokens, release is robust
+            LBWARN << "Send token timeout, reclaiming " << _maxTokens
+                   << " tokens" << std::endl;
+            _available = _maxTokens;
+            for( Shares::iterator i = _shares.begin(); i != _shares.end(); ++i)
+                i->second.held = i->second.preGranted = 0;
+        }
+        else
+            _expirePreGrants( time );
+    }
+    _getShare( node->getNodeID( )).time = time;
+
+    const Request request = { node, requestID, LB_MAX( weight, 1u ) };
+    _waiting.push_back( request );
+
+    const size_t nGrants = grants.size();
+    _schedule( grants );
+    if( grants.size() > nGrants )
+        _lastTime = time;
+}
+
+void SendTokenScheduler::release( NodePtr node, const bool streaming,
+                                  const uint64_t time, Grants& grants )
+{
+    _lastTime = time;
+    Share& share = _getShare( node->getNodeID( ));
+    share.time = time;
+    if( share.held > 0 ) // else double release due to timeout or expiry
+    {
+        --share.held;
+        share.preGranted = LB_MIN( share.preGranted, share.held );
+        if( _available < _maxTokens )
+            ++_available;
+    }
+
+    if( streaming )
+    {
+        // pre-grant the next token unless another node is entitled to it
+        const uint64_t pass = _getShare( node->getNodeID( )).pass;
+        bool preGrant = true;
+        for( Requests::const_iterator i = _waiting.begin();
+             i != _waiting.end(); ++i )
+        {
+            if( _getShare( i->node->getNodeID( )).pass <= pass )
+            {
+                preGrant = false;
+                break;
+            }
+        }
+        if( preGrant )
+            _grant( node, LB_UNDEFINED_UINT32, 0, grants );
+    }
+
+    _schedule( grants );
+}
+
+void SendTokenScheduler::remove( const NodeID& nodeID, Grants& grants )
+{
+    Shares::iterator i = _shares.find( nodeID );
+    if( i != _shares.end( ))
+    {
+        _available = LB_MIN( _available + i->second.held, _maxTokens );
+        _shares.erase( i );
+    }
+
+    for( Requests::iterator j = _waiting.begin(); j != _waiting.end(); )
+    {
+        if( j->node->getNodeID() == nodeID )
+            j = _waiting.erase( j );
+        else
+            ++j;
+    }
+    _schedule( grants );
+}
+
+SendTokenScheduler::Share& SendTokenScheduler::_getShare( const NodeID& nodeID )
+{
+    Shares::iterator i = _shares.find( nodeID );
+    if( i == _shares.end( ))
+    {
+        const Share share = { _pass, 0, 1, 0, 0 };
+        return _shares[ nodeID ] = share;
+    }
+
+    // idle nodes do not accumulate credit
+    if( i->second.pass < _pass )
+        i->second.pass = _pass;
+    return i->second;
+}
+
+void SendTokenScheduler::_grant( NodePtr node, const uint32_t requestID,
+                                 const uint32_t weight, Grants& grants )
+{
+    LBASSERT( _available > 0 );
+    --_available;
+
+    Share& share = _getShare( node->getNodeID( ));
+    if( weight > 0 ) // else pre-grant, reuse weight of last request
+        share.weight = weight;
+
+    _pass = share.pass;
+    share.pass += _stride / share.weight;
+    ++share.held;
+    if( requestID == LB_UNDEFINED_UINT32 )
+        ++share.preGranted;
+    grants.push_back( Grant( node, requestID ));
+}
+
+void SendTokenScheduler::_expirePreGrants( const uint64_t time )
+{
+    // A streaming sender may never use its pre-granted token
+    const uint64_t lease = Global::getKeepaliveTimeout();
+    for( Shares::iterator i = _shares.begin(); i != _shares.end(); ++i )
+    {
+        Share& share = i->second;
+        if( share.preGranted == 0 || time <= share.time + lease )
+            continue;
+
+        LBINFO << "Reclaiming " << share.preGranted << " unused send tokens of "
+               << i->first << std::endl;
+        _available = LB_MIN( _available + share.preGranted, _maxTokens );
+        share.held -= share.preGranted;
+        share.preGranted = 0;
+    }
+}
+
+void SendTokenScheduler::_schedule( Grants& grants )
+{
+    while( _available > 0 && !_waiting.empty( ))
+    {
+        // the waiting request with the lowest pass, FIFO for equal passes
+        Requests::iterator next = _waiting.begin();
+        uint64_t nextPass = _getShare( next->node->getNodeID( )).pass;
+        for( Requests::iterator i = next + 1; i != _waiting.end(); ++i )
+        {
+            const uint64_t pass = _getShare( i->node->getNodeID( )).pass;
+            if( pass < nextPass )
+            {
+                next = i;
+                nextPass = pass;
+            }
+        }
+
+        const Request request = *next;
+        _waiting.erase( next );
+        _grant( request.node, request.requestID, request.weight, grants );
+    }
+}
+
+}
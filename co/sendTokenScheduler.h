@@ -0,0 +1,137 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CO_SENDTOKENSCHEDULER_H
+#define CO_SENDTOKENSCHEDULER_H
+
+#include <co/api.h>
+#include <co/types.h>
+
+#include <lunchbox/stdExt.h> // member
+
+#include <deque>
+#include <vector>
+
+namespace co
+{
+    /**
+     * @internal
+     * Receiver-side scheduler of the send tokens of a LocalNode.
+     *
+     * Up to maxTokens tokens are granted concurrently. Waiting requests are
+     * served by stride scheduling, that is, each node receives a share of the
+     * tokens proportional to the weight of its requests. A node releasing a
+     * token as a streaming sender is granted the next token immediately when
+     * no other waiting node is entitled to it, saving the request round trip
+     * of its next transfer. Pre-granted tokens of a node without token
+     * activity for the keepalive timeout are reclaimed when tokens run out.
+     *
+     * Not thread-safe, used by the command thread.
+     */
+    class SendTokenScheduler
+    {
+    public:
+        /** A token granted to a node. */
+        struct Grant
+        {
+            Grant( NodePtr n, const uint32_t id ) : node( n ), requestID( id ){}
+
+            NodePtr node;
+            uint32_t requestID; //!< LB_UNDEFINED_UINT32 for pre-granted tokens
+        };
+        typedef std::vector< Grant > Grants;
+
+        /** Construct a new scheduler with one token. */
+        CO_API SendTokenScheduler();
+
+        /** Set the number of concurrent tokens. */
+        CO_API void setMaxTokens( const uint32_t maxTokens );
+
+        /** @return the number of concurrent tokens. */
+        uint32_t getMaxTokens() const { return _maxTokens; }
+
+        /** @return the number of currently available tokens. */
+        uint32_t getAvailable() const { return _available; }
+
+        /** @return the number of waiting requests. */
+        size_t getNumWaiting() const { return _waiting.size(); }
+
+        /**
+         * Request a token.
+         *
+         * @param node the requesting node.
+         * @param requestID the request of the node.
+         * @param weight the relative share of the node.
+         * @param time the current time.
+         * @param grants returns the tokens to be granted.
+         */
+        CO_API void request( NodePtr node, const uint32_t requestID,
+                             const uint32_t weight, const uint64_t time,
+                             Grants& grants );
+
+        /**
+         * Release a token.
+         *
+         * @param node the releasing node.
+         * @param streaming true if the node wants to send again.
+         * @param time the current time.
+         * @param grants returns the tokens to be granted.
+         */
+        CO_API void release( NodePtr node, const bool streaming,
+                             const uint64_t time, Grants& grants );
+
+        /**
+         * Reclaim the tokens and drop the requests of a disconnected node.
+         *
+         * @param nodeID the identifier of the disconnected node.
+         * @param grants returns the tokens to be granted.
+         */
+        CO_API void remove( const NodeID& nodeID, Grants& grants );
+
+    private:
+        struct Request
+        {
+            NodePtr node;
+            uint32_t requestID;
+            uint32_t weight;
+        };
+        typedef std::deque< Request > Requests;
+
+        struct Share
+        {
+            uint64_t pass;   //!< stride scheduling pass
+            uint64_t time;   //!< last token activity of the node
+            uint32_t weight; //!< weight of the last request
+            uint32_t held;   //!< granted and not yet released tokens
+            uint32_t preGranted; //!< held tokens which were pre-granted
+        };
+        typedef stde::hash_map< uint128_t, Share > Shares;
+
+        uint32_t _maxTokens;
+        uint32_t _available;
+        uint64_t _lastTime;  //!< last token activity, for timeout detection
+        uint64_t _pass;      //!< pass of the last grant
+        Requests _waiting;
+        Shares _shares;      //!< scheduling state per node
+
+        Share& _getShare( const NodeID& nodeID );
+        void _grant( NodePtr node, const uint32_t requestID,
+                     const uint32_t weight, Grants& grants );
+        void _schedule( Grants& grants );
+        void _expirePreGrants( const uint64_t time );
+    };
+}
+#endif // CO_SENDTOKENSCHEDULER_H
@@ -18,6 +18,7 @@
 
 #include "staticSlaveCM.h"
 
+#include "global.h"
 #include "log.h"
 #include "object.h"
 #include "objectDataICommand.h"
@@ -50,7 +51,10 @@ void StaticSlaveCM::applyMapData( const uint128_t& version )
 {
     LBASSERT( _currentIStream );
     LBASSERT( version == VERSION_FIRST );
-    _currentIStream->waitReady();
+    if( Global::getIAttribute( Global::IATTR_OBJECT_STREAMING ))
+        _currentIStream->waitStarted(); // unpack while receiving the rest
+    else
+        _currentIStream->waitReady();
 
     LBASSERT( _object );
     LBASSERT( _currentIStream->getVersion() == VERSION_FIRST );
@@ -63,6 +67,7 @@ void StaticSlaveCM::applyMapData( const uint128_t& version )
                   "Object " << typeid( *_object ).name() <<
                   " did not unpack all data" );
 
+    _currentIStream->waitReady();
     delete _currentIStream;
     _currentIStream = 0;
 
@@ -101,9 +106,13 @@ bool StaticSlaveCM::_cmdInstance( ICommand& command )
 {
     LB_TS_THREAD( _rcvThread );
     LBASSERT( _currentIStream );
-    _currentIStream->addDataCommand( command );
 
-    if( _currentIStream->isReady( ))
+    // The stream may be released by applyMapData() once it is ready
+    ObjectDataICommand dataCommand( command );
+    const bool isLast = dataCommand.isLast();
+    _currentIStream->addDataCommand( dataCommand );
+
+    if( isLast )
         LBLOG( LOG_OBJECTS ) << "id " << _object->getID() << "."
                              << _object->getInstanceID() << " ready"
                              << std::endl;
@@ -40,6 +40,8 @@ class Barrier;
 class Buffer;
 class CPUCompressor; //!< @internal
 class CommandQueue;
+class CommandStats;
+class CommandTrace;
 class Connection;
 class ConnectionDescription;
 class ConnectionListener;
@@ -68,6 +70,8 @@ class QueueSlave;
 class Serializable;
 class Zeroconf;
 struct CompressorInfo; //!< @internal
+struct ConnectionStats;
+struct InstanceCacheStats;
 template< class Q > class WorkerThread;
 struct ObjectVersion;
 
@@ -121,6 +125,11 @@ typedef Connections::const_iterator ConnectionsCIter;
 /** An iterator for a vector of ConnectionPtr's. */
 typedef Connections::iterator   ConnectionsIter;
 
+/** A vector of commands. */
+typedef std::vector< ICommand >                  ICommands;
+/** An iterator for a vector of commands. */
+typedef ICommands::iterator                      ICommandsIter;
+
 /** A vector of ConnectionDescriptionPtr's. */
 typedef std::vector< ConnectionDescriptionPtr >  ConnectionDescriptions;
 /** An iterator for a vector of ConnectionDescriptionPtr's. */
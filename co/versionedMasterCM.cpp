@@ -203,22 +203,32 @@ bool VersionedMasterCM::_cmdMaxVersion( ICommand& cmd )
     const uint64_t version = command.get< uint64_t >();
     const uint32_t slaveID = command.get< uint32_t >();
 
+    setSlaveMaxVersion( command.getNode(), slaveID, version );
+    return true;
+}
+
+void VersionedMasterCM::setSlaveMaxVersion( NodePtr node,
+                                            const uint32_t instanceID,
+                                            const uint64_t maxVersion )
+{
     Mutex mutex( _slaves );
 
     // Update slave's max version
     SlaveData data;
-    data.node = command.getNode();
-    data.instanceID = slaveID;
+    data.node = node;
+    data.instanceID = instanceID;
     SlaveDatasIter i = stde::find( _slaveData, data );
     if( i == _slaveData.end( ))
     {
-        LBWARN << "Got max version from unmapped slave" << std::endl;
-        return true;
+        // batched acks may arrive after the slave has unsubscribed
+        LBLOG( LOG_OBJECTS ) << "Got max version from unmapped slave"
+                             << std::endl;
+        return;
     }
-    i->maxVersion = version;
+    // direct and batched acks may arrive out of order
+    i->maxVersion = LB_MAX( i->maxVersion, maxVersion );
 
     _updateMaxVersion();
-    return true;
 }
 
 }
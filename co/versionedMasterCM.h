@@ -62,6 +62,9 @@ namespace co
         virtual void addSlave( MasterCMCommand command );
         virtual void removeSlave( NodePtr node, const uint32_t instanceID );
         virtual void removeSlaves( NodePtr node );
+        virtual void setSlaveMaxVersion( NodePtr node,
+                                         const uint32_t instanceID,
+                                         const uint64_t maxVersion );
         virtual const Nodes getSlaveNodes() const
             { Mutex mutex( _slaves ); return *_slaves; }
 
@@ -18,6 +18,7 @@
 
 #include "versionedSlaveCM.h"
 
+#include "global.h"
 #include "log.h"
 #include "object.h"
 #include "objectDataICommand.h"
@@ -34,6 +35,7 @@ VersionedSlaveCM::VersionedSlaveCM( Object* object, uint32_t masterInstanceID )
         : ObjectCM( object )
         , _version( VERSION_NONE )
         , _currentIStream( 0 )
+        , _streaming( false )
         , _masterInstanceID( masterInstanceID )
 #pragma warning(push)
 #pragma warning(disable: 4355)
@@ -53,6 +55,8 @@ VersionedSlaveCM::~VersionedSlaveCM()
     while( !_queuedVersions.isEmpty( ))
         delete _queuedVersions.pop();
 
+    if( _streaming ) // was queued and deleted above
+        _currentIStream = 0;
     LBASSERT( !_currentIStream );
     delete _currentIStream;
     _currentIStream = 0;
@@ -100,7 +104,13 @@ uint128_t VersionedSlaveCM::sync( const uint128_t& v )
                   " (" << _version << ", " << version <<")" );
 
     while( _version < version )
-        _unpackOneVersion( _queuedVersions.pop( ));
+    {
+        ObjectDataIStream* is = _queuedVersions.pop();
+        if( is->getVersion() < version && _isSkippable( is ))
+            _skipOneVersion( is );
+        else
+            _unpackOneVersion( is );
+    }
 
     LocalNodePtr node = _object->getLocalNode();
     if( node.isValid( ))
@@ -116,7 +126,13 @@ void VersionedSlaveCM::_syncToHead()
 
     ObjectDataIStream* is = 0;
     while( _queuedVersions.tryPop( is ))
-        _unpackOneVersion( is );
+    {
+        ObjectDataIStream* next = 0;
+        if( _queuedVersions.getFront( next ) && _isSkippable( is ))
+            _skipOneVersion( is );
+        else
+            _unpackOneVersion( is );
+    }
 
     LocalNodePtr localNode = _object->getLocalNode();
     if( localNode.isValid( ))
@@ -125,6 +141,8 @@ void VersionedSlaveCM::_syncToHead()
 
 void VersionedSlaveCM::_releaseStream( ObjectDataIStream* stream )
 {
+    // a streamed version might still be received when not read completely
+    stream->waitReady();
 #ifdef CO_AGGRESSIVE_CACHING
     stream->reset();
     _iStreamCache.release( stream );
@@ -173,14 +191,35 @@ void VersionedSlaveCM::_unpackOneVersion( ObjectDataIStream* is )
     _releaseStream( is );
 }
 
+bool VersionedSlaveCM::_isSkippable( const ObjectDataIStream* is ) const
+{
+    // Instance versions replace the whole object, older ones don't need to be
+    // applied when catching up to a newer version.
+    return _object->getChangeType() == Object::INSTANCE &&
+           is->hasInstanceData();
+}
+
+void VersionedSlaveCM::_skipOneVersion( ObjectDataIStream* is )
+{
+    LBASSERT( is );
+    LBASSERTINFO( _version == is->getVersion() - 1, "Expected version "
+                  << _version + 1 << ", got " << is->getVersion() << " for "
+                  << *_object );
+
+    // The ack of the next unpacked version acknowledges this one as well
+    _version = is->getVersion();
+    _releaseStream( is );
+}
+
 void VersionedSlaveCM::_sendAck()
 {
     const uint64_t maxVersion = _version.low() + _object->getMaxVersions();
     if( maxVersion <= _version.low( )) // overflow: default unblocking commit
         return;
 
-    _object->send( _master, CMD_OBJECT_MAX_VERSION, _masterInstanceID )
-            << maxVersion << _object->getInstanceID();
+    LocalNodePtr localNode = _object->getLocalNode();
+    localNode->ackMaxVersion( _master, _object->getID(), _masterInstanceID,
+                              maxVersion, _object->getInstanceID( ));
 }
 
 void VersionedSlaveCM::applyMapData( const uint128_t& version )
@@ -312,6 +351,22 @@ void VersionedSlaveCM::addInstanceDatas( const ObjectDataIStreamDeque& cache,
 #endif
 }
 
+void VersionedSlaveCM::_queueVersion( ObjectDataIStream* stream )
+{
+    LB_TS_THREAD( _rcvThread );
+    const uint128_t& version = stream->getVersion();
+#ifndef NDEBUG
+    ObjectDataIStream* debugStream = 0;
+    _queuedVersions.getBack( debugStream );
+    if ( debugStream )
+    {
+        LBASSERT( debugStream->getVersion() + 1 == version );
+    }
+#endif
+    _queuedVersions.push( stream );
+    _object->notifyNewHeadVersion( version );
+}
+
 //---------------------------------------------------------------------------
 // command handlers
 //---------------------------------------------------------------------------
@@ -325,27 +380,36 @@ bool VersionedSlaveCM::_cmdData( ICommand& cmd )
     if( !_currentIStream )
         _currentIStream = _iStreamCache.alloc();
 
+    // Don't use the stream after adding the last command, a streamed version
+    // may be released by the application thread at any time afterwards
+    const bool isLast = command.isLast();
     _currentIStream->addDataCommand( command );
-    if( _currentIStream->isReady( ))
+    if( isLast )
     {
-        const uint128_t& version = _currentIStream->getVersion();
 #if 0
-        LBLOG( LOG_OBJECTS ) << "v" << version << ", id " << _object->getID()
-                             << "." << _object->getInstanceID() << " ready"
+        LBLOG( LOG_OBJECTS ) << "v" << command.getVersion() << ", id "
+                             << _object->getID() << "."
+                             << _object->getInstanceID() << " ready"
                              << std::endl;
 #endif
-#ifndef NDEBUG
-        ObjectDataIStream* debugStream = 0;
-        _queuedVersions.getBack( debugStream );
-        if ( debugStream )
+        if( _streaming ) // already queued with its first command
+            _streaming = false;
+        else
         {
-            LBASSERT( debugStream->getVersion() + 1 == version );
+            if( Global::getIAttribute( Global::IATTR_OBJECT_PREFETCH ))
+                _object->getLocalNode()->decode( _currentIStream );
+            _queueVersion( _currentIStream );
         }
-#endif
-        _queuedVersions.push( _currentIStream );
-        _object->notifyNewHeadVersion( version );
         _currentIStream = 0;
     }
+    else if( !_streaming &&
+             Global::getIAttribute( Global::IATTR_OBJECT_STREAMING ))
+    {
+        // Multi-command version: let the application unpack the available
+        // data while the remainder is still being received
+        _streaming = true;
+        _queueVersion( _currentIStream );
+    }
     return true;
 }
 
@@ -72,6 +72,9 @@ namespace co
         /** istream for receiving the current version */
         ObjectDataIStream* _currentIStream;
 
+        /** True if _currentIStream is queued before being complete. */
+        bool _streaming;
+
         /** The change queue. */
         lunchbox::MTQueue< ObjectDataIStream* > _queuedVersions;
 
@@ -90,10 +93,17 @@ namespace co
         void _syncToHead();
         void _releaseStream( ObjectDataIStream* stream );
         void _sendAck();
+        void _queueVersion( ObjectDataIStream* stream );
 
         /** Apply the data in the input stream to the object */
         virtual void _unpackOneVersion( ObjectDataIStream* is );
 
+        /** @return true if the version may be skipped when catching up. */
+        bool _isSkippable( const ObjectDataIStream* is ) const;
+
+        /** Drop the input stream without applying its data. */
+        void _skipOneVersion( ObjectDataIStream* is );
+
         /* The command handlers. */
         bool _cmdData( ICommand& command );
 
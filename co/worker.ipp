@@ -24,15 +24,27 @@ namespace co
 {
 template< class Q > void WorkerThread< Q >::run()
 {
+    ICommands commands;
     while( !stopRunning( ))
     {
-        ICommand command = _commands.pop();
-        LBASSERT( command.isValid( ));
+        commands.push_back( _commands.pop( ));
+        _commands.popAll( commands );
 
-        if( !command( ))
+        for( ICommandsIter i = commands.begin(); i != commands.end(); ++i )
         {
-            LBABORT( "Error handling " << command );
+            ICommand& command = *i;
+            LBASSERT( command.isValid( ));
+
+            if( !command( ))
+            {
+                LBABORT( "Error handling " << command );
+            }
+            command.clear(); // release buffer early
+
+            if( stopRunning( ))
+                break;
         }
+        commands.clear();
 
         while( _commands.isEmpty( ))
             if( !notifyIdle( )) // nothing to do
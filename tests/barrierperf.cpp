@@ -0,0 +1,161 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Tests Barrier latency with in-process nodes over TCP loopback, and that the
+// fanout release is forwarded by the slaves without falling back to the master
+// Usage: ./barrierperf
+
+#include <test.h>
+
+#include <co/barrier.h>
+#include <co/barrierCommand.h> // private header
+#include <co/commandStats.h>
+#include <co/connectionDescription.h>
+#include <co/global.h>
+#include <co/init.h>
+#include <co/node.h>
+#include <lunchbox/clock.h>
+#include <lunchbox/rng.h>
+
+#include <iostream>
+
+#define N_NODES 8
+#define N_LOOPS 500
+#define N_WARMUP 4 // each tree level connects its children one round later
+
+namespace
+{
+uint64_t _getNumReleaseCommands( co::LocalNodePtr node )
+{
+    const co::CommandStats stats = node->getCommandStats();
+    const co::CommandStats::Entries& entries = stats.getEntries();
+    for( co::CommandStats::Entries::const_iterator i = entries.begin();
+         i != entries.end(); ++i )
+    {
+        if( i->type == co::COMMANDTYPE_OBJECT &&
+            i->command == co::CMD_BARRIER_RELEASE )
+        {
+            return i->count;
+        }
+    }
+    return 0;
+}
+}
+
+class Slave : public lunchbox::Thread
+{
+public:
+    Slave( const uint16_t port, const uint16_t masterPort, const co::UUID& id )
+        : _port( port ), _masterPort( masterPort ), _id( id ) {}
+
+    virtual void run()
+        {
+            co::ConnectionDescriptionPtr description =
+                new co::ConnectionDescription;
+            description->type = co::CONNECTIONTYPE_TCPIP;
+            description->port = _port;
+            description->setHostname( "localhost" );
+
+            co::LocalNodePtr node = new co::LocalNode;
+            node->addConnectionDescription( description );
+            TEST( node->listen( ));
+
+            co::NodePtr master = new co::Node;
+            co::ConnectionDescriptionPtr masterDesc =
+                new co::ConnectionDescription;
+            masterDesc->type = co::CONNECTIONTYPE_TCPIP;
+            masterDesc->port = _masterPort;
+            master->addConnectionDescription( masterDesc );
+            TEST( node->connect( master ));
+
+            co::Barrier barrier;
+            TEST( node->mapObject( &barrier, _id ));
+
+            for( size_t i = 0; i < N_WARMUP + N_LOOPS; ++i )
+                barrier.enter();
+
+            node->unmapObject( &barrier );
+            node->close();
+        }
+
+private:
+    const uint16_t _port;
+    const uint16_t _masterPort;
+    const co::UUID _id;
+};
+
+static void _testLatency( const uint16_t port, const int32_t fanout )
+{
+    co::Global::setIAttribute( co::Global::IATTR_BARRIER_FANOUT, fanout );
+
+    co::ConnectionDescriptionPtr description = new co::ConnectionDescription;
+    description->type = co::CONNECTIONTYPE_TCPIP;
+    description->port = port;
+
+    co::LocalNodePtr node = new co::LocalNode;
+    node->addConnectionDescription( description );
+    TEST( node->listen( ));
+
+    co::Barrier barrier( node, N_NODES );
+    TEST( node->registerObject( &barrier ));
+
+    Slave* slaves[ N_NODES - 1 ];
+    for( size_t i = 0; i < N_NODES - 1; ++i )
+    {
+        slaves[ i ] = new Slave( port + i + 1, port, barrier.getID( ));
+        slaves[ i ]->start();
+    }
+
+    // warm up, connects all slaves and the release tree
+    for( size_t i = 0; i < N_WARMUP; ++i )
+        barrier.enter();
+    node->resetCommandStats();
+
+    lunchbox::Clock clock;
+    for( size_t i = 0; i < N_LOOPS; ++i )
+        barrier.enter();
+    const float time = clock.getTimef();
+
+    std::cout << N_NODES << " nodes, fanout " << fanout << ": "
+              << time * 1000.f / N_LOOPS << " us/barrier" << std::endl;
+
+    const uint64_t nReleases = _getNumReleaseCommands( node );
+    TESTINFO( nReleases == 0,
+              nReleases << " releases fell back to the master" );
+
+    for( size_t i = 0; i < N_NODES - 1; ++i )
+    {
+        slaves[ i ]->join();
+        delete slaves[ i ];
+    }
+
+    node->deregisterObject( &barrier );
+    node->close();
+}
+
+int main( int argc, char **argv )
+{
+    TEST( co::init( argc, argv ));
+    lunchbox::RNG rng;
+    const uint16_t port = (rng.get<uint16_t>() % 60000) + 1024;
+
+    _testLatency( port, 0 );
+    _testLatency( port + N_NODES, 2 );
+
+    co::Global::setIAttribute( co::Global::IATTR_BARRIER_FANOUT, 0 );
+    co::exit();
+    return EXIT_SUCCESS;
+}
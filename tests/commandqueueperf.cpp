@@ -0,0 +1,147 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Tests CommandQueue handoff latency and throughput, e.g., from the receiver to
+// the command thread
+// Usage: ./commandqueueperf
+
+#include <test.h>
+
+#include <co/buffer.h>
+#include <co/bufferCache.h>
+#include <co/commandQueue.h>
+#include <co/iCommand.h>
+#include <co/init.h>
+#include <co/oCommand.h>
+#include <lunchbox/clock.h>
+
+#include <iostream>
+
+#define N_PINGS 100000
+#define N_PRODUCERS 4
+#define N_COMMANDS 250000
+
+/** Returns each command popped from one queue on another queue. */
+class Echo : public lunchbox::Thread
+{
+public:
+    Echo( co::CommandQueue& in, co::CommandQueue& out )
+        : _in( in ), _out( out ) {}
+
+protected:
+    virtual void run()
+        {
+            for( size_t i = 0; i < N_PINGS; ++i )
+                _out.push( _in.pop( ));
+        }
+
+private:
+    co::CommandQueue& _in;
+    co::CommandQueue& _out;
+};
+
+/** Pushes N_COMMANDS commands onto a queue. */
+class Producer : public lunchbox::Thread
+{
+public:
+    Producer() : queue( 0 ) {}
+
+    co::CommandQueue* queue;
+    co::ICommand command;
+
+protected:
+    virtual void run()
+        {
+            for( size_t i = 0; i < N_COMMANDS; ++i )
+                queue->push( command );
+        }
+};
+
+int main( int argc, char **argv )
+{
+    TEST( co::init( argc, argv ));
+    {
+        co::BufferCache cache( 1 );
+        const uint64_t size = co::OCommand::getSize();
+        co::BufferPtr buffer = cache.alloc( co::Buffer::getCacheSize( ));
+        buffer->resize( size );
+        reinterpret_cast< uint64_t* >( buffer->getData( ))[ 0 ] = size;
+
+        co::ICommand command( 0, 0, buffer, false /*swap*/ );
+        command.setCommand( 0 );
+        command.setType( co::COMMANDTYPE_CUSTOM );
+
+        // latency: ping-pong through two queues
+        {
+            co::CommandQueue ping;
+            co::CommandQueue pong;
+            Echo echo( ping, pong );
+            TEST( echo.start( ));
+
+            lunchbox::Clock clock;
+            for( size_t i = 0; i < N_PINGS; ++i )
+            {
+                ping.push( command );
+                TEST( pong.pop().isValid( ));
+            }
+            const float time = clock.getTimef();
+            TEST( echo.join( ));
+
+            std::cout << "Handoff latency " << time * 1000.f / N_PINGS / 2.f
+                      << " us" << std::endl;
+        }
+
+        // throughput: many producers, one consumer
+        for( size_t batch = 0; batch < 2; ++batch )
+        {
+            co::CommandQueue queue;
+            Producer producers[ N_PRODUCERS ];
+            for( size_t i = 0; i < N_PRODUCERS; ++i )
+            {
+                producers[i].queue = &queue;
+                producers[i].command = command;
+            }
+
+            lunchbox::Clock clock;
+            for( size_t i = 0; i < N_PRODUCERS; ++i )
+                TEST( producers[i].start( ));
+
+            co::ICommands commands;
+            size_t nPopped = 0;
+            while( nPopped < N_PRODUCERS * N_COMMANDS )
+            {
+                TEST( queue.pop().isValid( ));
+                ++nPopped;
+                if( batch )
+                {
+                    nPopped += queue.popAll( commands );
+                    commands.clear();
+                }
+            }
+            const float time = clock.getTimef();
+
+            for( size_t i = 0; i < N_PRODUCERS; ++i )
+                TEST( producers[i].join( ));
+            TEST( queue.isEmpty( ));
+
+            std::cout << N_PRODUCERS << " producers, "
+                      << ( batch ? "batch pop: " : "single pop: " )
+                      << nPopped / time << " commands/ms" << std::endl;
+        }
+    }
+    TEST( co::exit( ));
+    return EXIT_SUCCESS;
+}
@@ -21,6 +21,7 @@
 #include <co/connection.h>
 #include <co/connectionDescription.h>
 #include <co/connectionSet.h>
+#include <co/connectionStats.h>
 #include <co/init.h>
 
 #include <lunchbox/monitor.h>
@@ -105,6 +106,14 @@ int main( int argc, char **argv )
         TEST( syncBuffer == &buffer );
         TEST( buffer.getSize() == PACKETSIZE );
 
+        const co::ConnectionStats writeStats = writer->getStats();
+        const co::ConnectionStats readStats = reader->getStats();
+        TESTINFO( writeStats.sends == 1, writeStats );
+        TESTINFO( writeStats.bytesSent == PACKETSIZE, writeStats );
+        TESTINFO( writeStats.sendQueueDepth == 0, writeStats );
+        TESTINFO( readStats.receives == 1, readStats );
+        TESTINFO( readStats.bytesReceived == PACKETSIZE, readStats );
+
         writer->close();
         buffer.setSize( 0 );
         reader->recvNB( &buffer, PACKETSIZE );
@@ -19,6 +19,7 @@
 #include <test.h>
 
 #include <co/co.h>
+#include <co/nodeCommand.h> // private header
 
 #include <boost/bind.hpp>
 
@@ -51,6 +52,7 @@ typedef lunchbox::RefPtr< MyLocalNode > MyLocalNodePtr;
 int main( int argc, char **argv )
 {
     TEST( co::init( argc, argv ) );
+    co::Global::setIAttribute( co::Global::IATTR_COMMAND_TRACE, 1000 );
 
     co::ConnectionDescriptionPtr connDesc = new co::ConnectionDescription;
 
@@ -93,6 +95,34 @@ int main( int argc, char **argv )
     TEST( client->close( ));
     TEST( server->close( ));
 
+    // both custom commands were recorded, one of them queued
+    const co::CommandStats stats = server->getCommandStats();
+    std::cout << stats;
+    bool gotQueued = false;
+    bool gotDirect = false;
+    const co::CommandStats::Entries& entries = stats.getEntries();
+    for( co::CommandStats::Entries::const_iterator i = entries.begin();
+         i != entries.end(); ++i )
+    {
+        if( i->type != co::COMMANDTYPE_NODE ||
+            i->command != co::CMD_NODE_COMMAND )
+        {
+            continue;
+        }
+        TEST( i->count >= 2 );
+        TEST( i->handlerTime.getCount() == i->count );
+        gotQueued = i->queueTime.getCount() > 0;
+        gotDirect = i->queueTime.getCount() < i->count;
+    }
+    TEST( gotQueued );
+    TEST( gotDirect );
+
+    // the custom commands were traced
+    std::ostringstream trace;
+    server->exportCommandTrace( trace );
+    TESTINFO( trace.str().find( "\"cat\":\"handler\"" ) != std::string::npos,
+              trace.str( ));
+
     serverProxy->printHolders( std::cerr );
     TESTINFO( serverProxy->getRefCount() == 1, serverProxy->getRefCount( ));
     TESTINFO( client->getRefCount() == 1, client->getRefCount( ));
@@ -29,6 +29,8 @@
 
 #include <lunchbox/thread.h>
 
+#include <string.h>
+
 #include <co/objectDataOCommand.h> // private header
 #include <co/objectDataICommand.h> // private header
 #include <co/cpuCompressor.h> // private header
@@ -36,9 +38,26 @@
 // Tests the functionality of the DataOStream and DataIStream
 
 #define CONTAINER_SIZE LB_64KB
+#define COMPRESSED_SIZE LB_128KB
+#define TAIL_SIZE 2048
 
 static std::string _message( "So long, and thanks for all the fish" );
 
+/** @return reproducible, uncompressible data. */
+static std::vector< uint64_t > _getRandomData()
+{
+    std::vector< uint64_t > data( COMPRESSED_SIZE / sizeof( uint64_t ));
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for( size_t i = 0; i < data.size(); ++i )
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        data[i] = state * 2685821657736338717ull;
+    }
+    return data;
+}
+
 class DataOStream : public co::DataOStream
 {
 public:
@@ -57,7 +76,7 @@ protected:
 class DataIStream : public co::DataIStream
 {
 public:
-    DataIStream() : co::DataIStream( false /*swap*/ ){}
+    DataIStream() : co::DataIStream( false /*swap*/ ), _nCompressed( 0 ) {}
 
     void addDataCommand( co::ConstBufferPtr buffer )
         {
@@ -86,9 +105,14 @@ protected:
             compressor = command.getCompressor();
             nChunks = command.getChunks();
             *chunkData = command.getRemainingBuffer( size );
+            if( compressor != EQ_COMPRESSOR_NONE )
+                ++_nCompressed;
             return true;
         }
 
+public:
+    size_t _nCompressed;
+
 private:
     co::CommandQueue _commands;
 };
@@ -111,6 +135,16 @@ public:
 
 protected:
     virtual void run()
+        {
+            _sendData();
+            _sendCompressed();
+            _sendRandom();
+        }
+
+private:
+    lunchbox::RefPtr< co::Connection > _connection;
+
+    void _sendData()
         {
             ::DataOStream stream;
 
@@ -129,28 +163,57 @@ protected:
             stream << doubles;
             stream << _message;
 
+            // small writes bucketized into multiple blocks
+            for( uint32_t i = 0; i < CONTAINER_SIZE; ++i )
+                stream << i;
+            stream << doubles;
+
             stream.disable();
         }
 
-private:
-    lunchbox::RefPtr< co::Connection > _connection;
+    void _sendCompressed()
+        {
+            ::DataOStream stream;
+
+            stream._initCompressor( co::CPUCompressor::chooseCompressor(
+                                        EQ_COMPRESSOR_DATATYPE_BYTE ));
+            stream._setupConnection( _connection );
+            stream._enable();
+
+            // large writes, each sent in its own compressed buffer
+            const std::vector< uint8_t > zeros( COMPRESSED_SIZE, 0 );
+            stream << co::Array< const uint8_t >( &zeros.front(),
+                                                  COMPRESSED_SIZE );
+            stream << co::Array< const uint8_t >( &zeros.front(),
+                                                  COMPRESSED_SIZE );
+
+            const std::vector< uint8_t > tail( TAIL_SIZE, 1 );
+            stream << co::Array< const uint8_t >( &tail.front(), TAIL_SIZE );
+
+            stream.disable();
+        }
+
+    void _sendRandom()
+        {
+            ::DataOStream stream;
+
+            stream._initCompressor( co::CPUCompressor::chooseCompressor(
+                                        EQ_COMPRESSOR_DATATYPE_BYTE ));
+            stream._setupConnection( _connection );
+            stream._enable();
+
+            // uncompressible, detected by sampling and sent as is
+            stream << _getRandomData();
+            stream << _message;
+
+            stream.disable();
+        }
 };
 }
 }
 
-int main( int argc, char **argv )
+static void _receive( co::ConnectionPtr connection, ::DataIStream& stream )
 {
-    co::init( argc, argv );
-    co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
-    desc->type = co::CONNECTIONTYPE_PIPE;
-    co::ConnectionPtr connection = co::Connection::create( desc );
-
-    TEST( connection->connect( ));
-    TEST( connection->isConnected( ));
-    co::DataStreamTest::Sender sender( connection->acceptSync( ));
-    TEST( sender.start( ));
-
-    ::DataIStream stream;
     co::BufferCache bufferCache( 200 );
     bool receiving = true;
     const size_t minSize = co::Buffer::getMinSize();
@@ -193,6 +256,22 @@ int main( int argc, char **argv )
                 TESTINFO( false, command.getCommand( ));
         }
     }
+}
+
+int main( int argc, char **argv )
+{
+    co::init( argc, argv );
+    co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
+    desc->type = co::CONNECTIONTYPE_PIPE;
+    co::ConnectionPtr connection = co::Connection::create( desc );
+
+    TEST( connection->connect( ));
+    TEST( connection->isConnected( ));
+    co::DataStreamTest::Sender sender( connection->acceptSync( ));
+    TEST( sender.start( ));
+
+    ::DataIStream stream;
+    _receive( connection, stream );
 
     int foo;
     stream >> foo;
@@ -217,6 +296,59 @@ int main( int argc, char **argv )
     TESTINFO( message == _message,
               '\'' <<  message << "' != '" << _message << '\'' );
 
+    // asymmetric read spanning multiple blocks
+    std::vector< uint32_t > ints( CONTAINER_SIZE );
+    stream >> co::Array< uint32_t >( &ints.front(), CONTAINER_SIZE );
+    for( uint32_t i = 0; i < CONTAINER_SIZE; ++i )
+        TESTINFO( ints[i] == i, ints[i] << " != " << i );
+
+    // zero-copy views
+    uint64_t nElems = 0;
+    stream >> nElems;
+    TEST( nElems == CONTAINER_SIZE );
+
+    const uint8_t* expected = reinterpret_cast< const uint8_t* >( &doubles[0] );
+    uint64_t size = 0;
+    for( uint64_t left = nElems * sizeof( double ); left > 0; left -= size )
+    {
+        const void* view = stream.getNextView( left, size );
+        TEST( view );
+        TEST( size > 0 && size <= left );
+        TEST( ::memcmp( view, expected, size ) == 0 );
+        expected += size;
+    }
+    TEST( !stream.hasData( ));
+
+    // compressed buffers decompressed directly into the destination
+    ::DataIStream compressed;
+    _receive( connection, compressed );
+
+    std::vector< uint8_t > data( COMPRESSED_SIZE, 0xff );
+    compressed >> co::Array< uint8_t >( &data.front(), COMPRESSED_SIZE );
+    for( size_t i = 0; i < COMPRESSED_SIZE; ++i )
+        TESTINFO( data[i] == 0, i << ": " << int( data[i] ));
+
+    // read larger than one compressed buffer
+    data.assign( COMPRESSED_SIZE + TAIL_SIZE, 0xff );
+    compressed >> co::Array< uint8_t >( &data.front(),
+                                        COMPRESSED_SIZE + TAIL_SIZE );
+    for( size_t i = 0; i < COMPRESSED_SIZE + TAIL_SIZE; ++i )
+        TESTINFO( data[i] == ( i < COMPRESSED_SIZE ? 0 : 1 ),
+                  i << ": " << int( data[i] ));
+    TEST( !compressed.hasData( ));
+    TESTINFO( compressed._nCompressed >= 2, compressed._nCompressed );
+
+    // uncompressible data is sent uncompressed
+    ::DataIStream random;
+    _receive( connection, random );
+
+    std::vector< uint64_t > randomData;
+    random >> randomData >> message;
+    TEST( randomData == _getRandomData( ));
+    TEST( message == _message );
+    TEST( !random.hasData( ));
+    TESTINFO( random._nCompressed == 0, random._nCompressed );
+
     TEST( sender.join( ));
     connection->close();
     return EXIT_SUCCESS;
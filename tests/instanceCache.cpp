@@ -25,6 +25,7 @@
 #include <co/buffer.h>
 #include <co/init.h>
 #include <co/instanceCache.h>
+#include <co/instanceCacheFile.h>
 #include <co/nodeCommand.h>
 #include <co/localNode.h>
 #include <co/objectDataICommand.h>
@@ -34,6 +35,8 @@
 #include <lunchbox/rng.h>
 #include <lunchbox/thread.h>
 
+#include <cstdio>
+
 
 // Tests the functionality of the instance cache
 
@@ -158,6 +161,78 @@ int main( int argc, char **argv )
     std::cout << cache << std::endl;
 
     TESTINFO( cache.getSize() == 0, cache.getSize( ));
+    co::InstanceCacheStats stats = cache.getStats();
+    TESTINFO( stats.hits <= stats.reads, stats );
+    TESTINFO( stats.items == 0, stats );
+
+    // Test eviction within the byte budget
+    co::InstanceCache smallCache( LB_1MB );
+    for( lunchbox::UUID key; key.low() < 1024; ++key )
+        TEST( smallCache.add( co::ObjectVersion( key, 1 ), 1, in ));
+
+    stats = smallCache.getStats();
+    TESTINFO( stats.writes == 1024, stats );
+    TESTINFO( stats.evictions > 0, stats );
+    TESTINFO( stats.size <= LB_1MB, stats );
+    TESTINFO( stats.size == smallCache.getSize(), stats );
+
+    // the most recently added item survives the eviction of older ones
+    const lunchbox::UUID lastKey( 0, 1023 );
+    TEST( smallCache[ lastKey ] != co::InstanceCache::Data::NONE );
+    TEST( smallCache.release( lastKey, 1 ));
+    TEST( smallCache.erase( lastKey ));
+    TEST( smallCache[ lastKey ] == co::InstanceCache::Data::NONE );
+    stats = smallCache.getStats();
+    TESTINFO( stats.getMisses() == 1, stats );
+
+    // Test an item larger than the budget share of one shard
+    const uint64_t bigSize = LB_1MB / 4;
+    co::BufferPtr bigBuffer = node->allocBuffer( bigSize );
+    bigBuffer->replace( in.getBuffer()->getData(), in.getBuffer()->getSize( ));
+    bigBuffer->resize( bigSize );
+    reinterpret_cast< uint64_t* >( bigBuffer->getData( ))[ 0 ] = bigSize;
+    co::ObjectDataICommand bigIn( node, node, bigBuffer, false );
+
+    const lunchbox::UUID bigKey( 1, 0 );
+    TEST( smallCache.add( co::ObjectVersion( bigKey, 1 ), 1, bigIn ));
+    TEST( smallCache[ bigKey ] != co::InstanceCache::Data::NONE );
+    TEST( smallCache.release( bigKey, 1 ));
+    stats = smallCache.getStats();
+    TESTINFO( stats.size >= bigSize && stats.size <= LB_1MB, stats );
+
+#ifndef _WIN32
+    // Test the persistent cache file across reopening
+    const std::string filename( "instanceCache.tmp" );
+    {
+        co::InstanceCacheFile file;
+        TEST( file.open( filename, 10 * LB_1MB ));
+        for( lunchbox::UUID key; key.low() < 16; ++key )
+            file.add( co::ObjectVersion( key, 1 ), 1, in );
+        file.flush();
+        TESTINFO( file.getSize() == 16, file.getSize( ));
+
+        // only the newest version of an object is kept
+        file.add( co::ObjectVersion( lunchbox::UUID( 0, 7 ), 2 ), 1, in );
+        file.add( co::ObjectVersion( lunchbox::UUID( 0, 7 ), 1 ), 1, in );
+        file.flush();
+        TESTINFO( file.getSize() == 16, file.getSize( ));
+    }
+    {
+        co::InstanceCacheFile file;
+        TEST( file.open( filename, 10 * LB_1MB ));
+        TESTINFO( file.getSize() == 16, file.getSize( ));
+
+        co::InstanceCache fileCache;
+        const lunchbox::UUID key( 0, 7 );
+        TEST( file.load( key, node, node, fileCache ) == 1 );
+        TEST( file.load( key, node, node, fileCache ) == 0 );
+        TEST( fileCache[ key ] != co::InstanceCache::Data::NONE );
+        TEST( fileCache.release( key, 1 ));
+        TEST( fileCache.erase( key ));
+    }
+    ::remove( filename.c_str( ));
+#endif
+
     TEST( co::exit( ));
     return EXIT_SUCCESS;
 }
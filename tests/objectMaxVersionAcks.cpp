@@ -0,0 +1,187 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Tests that max version acks of several slaves are coalesced per master node
+// and still delivered, unblocking the master commits.
+
+#include <test.h>
+
+#include <co/co.h>
+#include <co/nodeCommand.h> // private header
+#include <lunchbox/monitor.h>
+#include <lunchbox/rng.h>
+#include <lunchbox/sleep.h>
+
+#include <boost/bind.hpp>
+
+#include <iostream>
+
+#define N_OBJECTS 8
+
+namespace
+{
+const co::uint128_t _blockCmd( lunchbox::make_uint128( "blockCommandThread" ));
+lunchbox::Monitor< bool > _blocked;
+lunchbox::Monitor< bool > _released;
+
+bool _cmdBlock( co::CustomICommand& )
+{
+    _blocked = true;
+    _released.waitEQ( true );
+    return true;
+}
+
+class Object : public co::Object
+{
+public:
+    Object() : _value( 0 ) {}
+
+    void increment() { ++_value; }
+    uint32_t getValue() const { return _value; }
+
+protected:
+    virtual ChangeType getChangeType() const { return UNBUFFERED; }
+    virtual uint64_t getMaxVersions() const { return 1; }
+
+    virtual void getInstanceData( co::DataOStream& os ) { os << _value; }
+    virtual void applyInstanceData( co::DataIStream& is ) { is >> _value; }
+
+private:
+    uint32_t _value;
+};
+
+uint64_t _getNumMaxVersionCommands( co::LocalNodePtr node )
+{
+    const co::CommandStats stats = node->getCommandStats();
+    const co::CommandStats::Entries& entries = stats.getEntries();
+    for( co::CommandStats::Entries::const_iterator i = entries.begin();
+         i != entries.end(); ++i )
+    {
+        if( i->type == co::COMMANDTYPE_NODE &&
+            i->command == co::CMD_NODE_OBJECT_MAX_VERSIONS )
+        {
+            return i->count;
+        }
+    }
+    return 0;
+}
+}
+
+int main( int argc, char **argv )
+{
+    TEST( co::init( argc, argv ));
+    lunchbox::RNG rng;
+    const uint16_t port = (rng.get<uint16_t>() % 60000) + 1024;
+
+    co::LocalNodePtr server = new co::LocalNode;
+    co::ConnectionDescriptionPtr connDesc = new co::ConnectionDescription;
+
+    connDesc->type = co::CONNECTIONTYPE_TCPIP;
+    connDesc->port = port;
+    connDesc->setHostname( "localhost" );
+
+    server->addConnectionDescription( connDesc );
+    TEST( server->listen( ));
+
+    co::NodePtr serverProxy = new co::Node;
+    serverProxy->addConnectionDescription( connDesc );
+
+    connDesc = new co::ConnectionDescription;
+    connDesc->type = co::CONNECTIONTYPE_TCPIP;
+    connDesc->setHostname( "localhost" );
+
+    co::LocalNodePtr client = new co::LocalNode;
+    client->addConnectionDescription( connDesc );
+    TEST( client->listen( ));
+    TEST( client->connect( serverProxy ));
+
+    server->registerCommandHandler( _blockCmd, boost::bind( &_cmdBlock, _1 ),
+                                    server->getCommandThreadQueue( ));
+
+    Object masters[ N_OBJECTS ];
+    Object slaves[ N_OBJECTS ];
+    for( size_t i = 0; i < N_OBJECTS; ++i )
+    {
+        TEST( client->registerObject( &masters[i] ));
+        TEST( server->mapObject( &slaves[i], masters[i].getID( )));
+    }
+
+    co::uint128_t versions[ N_OBJECTS ];
+    for( size_t i = 0; i < N_OBJECTS; ++i )
+    {
+        masters[i].increment();
+        versions[i] = masters[i].commit();
+    }
+
+    // warm up: deliver the acks of the mapping and of the first version
+    for( size_t i = 0; i < N_OBJECTS; ++i )
+        TEST( slaves[i].sync( versions[i] ) == versions[i] );
+    for( size_t i = 0; i < N_OBJECTS; ++i )
+    {
+        masters[i].increment();
+        versions[i] = masters[i].commit();
+    }
+
+    // Hold the flush of queued acks in the slaves' command thread
+    serverProxy->send( _blockCmd );
+    _blocked.waitEQ( true );
+    client->resetCommandStats();
+
+    for( size_t i = 0; i < N_OBJECTS; ++i )
+    {
+        TEST( slaves[i].sync( versions[i] ) == versions[i] );
+        TEST( slaves[i].getValue() == masters[i].getValue( ));
+    }
+    _released = true;
+
+    // Each commit waits for the ack of the previous version
+    for( size_t i = 0; i < N_OBJECTS; ++i )
+    {
+        masters[i].increment();
+        masters[i].commit();
+    }
+
+    // The first ack was sent directly, all others in one flushed command
+    uint64_t nCommands = _getNumMaxVersionCommands( client );
+    for( size_t i = 0; i < 100 && nCommands < 2; ++i )
+    {
+        lunchbox::sleep( 10 ); // statistics are recorded after the handler
+        nCommands = _getNumMaxVersionCommands( client );
+    }
+    TESTINFO( nCommands >= 2 && nCommands < N_OBJECTS, nCommands );
+
+    for( size_t i = 0; i < N_OBJECTS; ++i )
+    {
+        server->unmapObject( &slaves[i] );
+        client->deregisterObject( &masters[i] );
+    }
+
+    TEST( client->disconnect( serverProxy ));
+    TEST( client->close( ));
+    TEST( server->close( ));
+
+    serverProxy->printHolders( std::cerr );
+    TESTINFO( serverProxy->getRefCount() == 1, serverProxy->getRefCount( ));
+    TESTINFO( client->getRefCount() == 1, client->getRefCount( ));
+    TESTINFO( server->getRefCount() == 1, server->getRefCount( ));
+
+    serverProxy = 0;
+    client      = 0;
+    server      = 0;
+
+    TEST( co::exit( ));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+
+/* Copyright (c) 2012, Stefan Eilemann <eile@eyescale.ch>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Tests syncing large slave versions decoded by the decoder thread and unpacked
+// while being received
+
+#include <test.h>
+
+#include <co/connectionDescription.h>
+#include <co/dataIStream.h>
+#include <co/dataOStream.h>
+#include <co/global.h>
+#include <co/init.h>
+#include <co/node.h>
+#include <co/object.h>
+#include <lunchbox/rng.h>
+
+#include <iostream>
+
+namespace
+{
+static const size_t N_VERSIONS = 10;
+static const size_t DATA_SIZE = 1024 * 1024;
+
+class Object : public co::Object
+{
+public:
+    Object() : _data( DATA_SIZE, 0 ), _counter( 0 ) {}
+
+    void update()
+        {
+            ++_counter;
+            for( size_t i = 0; i < _data.size(); i += 4096 )
+                _data[ i ] = uint8_t( _counter );
+        }
+
+    uint32_t getCounter() const { return _counter; }
+
+protected:
+    virtual ChangeType getChangeType() const { return INSTANCE; }
+
+    virtual void getInstanceData( co::DataOStream& os )
+        { os << _counter << _data; }
+
+    virtual void applyInstanceData( co::DataIStream& is )
+        {
+            is >> _counter >> _data;
+            TESTINFO( _data.size() == DATA_SIZE, _data.size( ));
+            for( size_t i = 0; i < _data.size(); i += 4096 )
+                TESTINFO( _data[ i ] == uint8_t( _counter ),
+                          int( _data[ i ] ) << " != " << _counter );
+        }
+
+private:
+    std::vector< uint8_t > _data;
+    uint32_t _counter;
+};
+
+void _testSync( co::LocalNodePtr client, co::LocalNodePtr server )
+{
+    Object master;
+    TEST( client->registerObject( &master ));
+
+    Object slave;
+    TEST( server->mapObject( &slave, master.getID( )));
+
+    for( size_t i = 0; i < N_VERSIONS; ++i )
+    {
+        master.update();
+        const co::uint128_t& version = master.commit();
+        slave.sync( version );
+        TESTINFO( slave.getCounter() == master.getCounter(),
+                  slave.getCounter() << " != " << master.getCounter( ));
+    }
+
+    // queue versions before syncing them at once
+    for( size_t i = 0; i < N_VERSIONS; ++i )
+    {
+        master.update();
+        master.commit();
+    }
+    slave.sync( master.getVersion( ));
+    TESTINFO( slave.getCounter() == master.getCounter(),
+              slave.getCounter() << " != " << master.getCounter( ));
+
+    server->unmapObject( &slave );
+    client->deregisterObject( &master );
+}
+}
+
+int main( int argc, char **argv )
+{
+    co::init( argc, argv );
+
+    lunchbox::RNG rng;
+    const uint16_t port = (rng.get<uint16_t>() % 60000) + 1024;
+
+    co::LocalNodePtr server = new co::LocalNode;
+    co::ConnectionDescriptionPtr connDesc = new co::ConnectionDescription;
+
+    connDesc->type = co::CONNECTIONTYPE_TCPIP;
+    connDesc->port = port;
+    connDesc->setHostname( "localhost" );
+
+    server->addConnectionDescription( connDesc );
+    TEST( server->listen( ));
+
+    co::NodePtr serverProxy = new co::Node;
+    serverProxy->addConnectionDescription( connDesc );
+
+    connDesc = new co::ConnectionDescription;
+    connDesc->type = co::CONNECTIONTYPE_TCPIP;
+    connDesc->setHostname( "localhost" );
+
+    co::LocalNodePtr client = new co::LocalNode;
+    client->addConnectionDescription( connDesc );
+    TEST( client->listen( ));
+    TEST( client->connect( serverProxy ));
+
+    co::Global::setIAttribute( co::Global::IATTR_OBJECT_PREFETCH, 1 );
+    _testSync( client, server );
+    co::Global::setIAttribute( co::Global::IATTR_OBJECT_PREFETCH, 0 );
+
+    co::Global::setIAttribute( co::Global::IATTR_OBJECT_STREAMING, 1 );
+    _testSync( client, server );
+    co::Global::setIAttribute( co::Global::IATTR_OBJECT_STREAMING, 0 );
+
+    TEST( client->disconnect( serverProxy ));
+    TEST( client->close( ));
+    TEST( server->close( ));
+
+    serverProxy = 0;
+    client      = 0;
+    server      = 0;
+
+    TEST( co::exit( ));
+    return EXIT_SUCCESS;
+}
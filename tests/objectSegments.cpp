@@ -0,0 +1,150 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Tests that instance data saved in several segments is mapped and synced
+// correctly, using both buffered small writes and large single writes.
+
+#include <test.h>
+
+#include <co/connectionDescription.h>
+#include <co/dataIStream.h>
+#include <co/dataOStream.h>
+#include <co/global.h>
+#include <co/init.h>
+#include <co/node.h>
+#include <co/object.h>
+#include <lunchbox/rng.h>
+
+#include <iostream>
+
+namespace
+{
+static const size_t _nValues = 3 * co::Global::getObjectBufferSize() /
+                               sizeof( uint32_t );
+
+class Object : public co::Object
+{
+public:
+    Object() : _seed( 0 ) {}
+
+    void setSeed( const uint32_t seed ) { _seed = seed; }
+    uint32_t getSeed() const { return _seed; }
+
+protected:
+    virtual ChangeType getChangeType() const { return INSTANCE; }
+
+    virtual void getInstanceData( co::DataOStream& os )
+        {
+            os << _seed;
+
+            // buffered writes spanning several pooled segments
+            for( size_t i = 0; i < _nValues; ++i )
+                os << uint32_t( _seed + i );
+
+            // a large write getting its own segment
+            std::vector< uint32_t > values( _nValues );
+            for( size_t i = 0; i < _nValues; ++i )
+                values[i] = uint32_t( _seed * i );
+            os << values;
+        }
+
+    virtual void applyInstanceData( co::DataIStream& is )
+        {
+            is >> _seed;
+            for( size_t i = 0; i < _nValues; ++i )
+            {
+                uint32_t value = 0;
+                is >> value;
+                TESTINFO( value == uint32_t( _seed + i ), i << ": " << value );
+            }
+
+            std::vector< uint32_t > values;
+            is >> values;
+            TESTINFO( values.size() == _nValues, values.size( ));
+            for( size_t i = 0; i < values.size(); ++i )
+                TESTINFO( values[i] == uint32_t( _seed * i ),
+                          i << ": " << values[i] );
+            TEST( !is.hasData( ));
+        }
+
+private:
+    uint32_t _seed;
+};
+}
+
+int main( int argc, char **argv )
+{
+    co::init( argc, argv );
+    lunchbox::RNG rng;
+    const uint16_t port = (rng.get<uint16_t>() % 60000) + 1024;
+
+    co::LocalNodePtr server = new co::LocalNode;
+    co::ConnectionDescriptionPtr connDesc = new co::ConnectionDescription;
+
+    connDesc->type = co::CONNECTIONTYPE_TCPIP;
+    connDesc->port = port;
+    connDesc->setHostname( "localhost" );
+
+    server->addConnectionDescription( connDesc );
+    TEST( server->listen( ));
+
+    co::NodePtr serverProxy = new co::Node;
+    serverProxy->addConnectionDescription( connDesc );
+
+    connDesc = new co::ConnectionDescription;
+    connDesc->type = co::CONNECTIONTYPE_TCPIP;
+    connDesc->setHostname( "localhost" );
+
+    co::LocalNodePtr client = new co::LocalNode;
+    client->addConnectionDescription( connDesc );
+    TEST( client->listen( ));
+    TEST( client->connect( serverProxy ));
+
+    // map from the segments saved at registration
+    Object master;
+    master.setSeed( 42 );
+    TEST( client->registerObject( &master ));
+
+    Object slave;
+    TEST( server->mapObject( &slave, master.getID( )));
+    TEST( slave.getSeed() == 42 );
+
+    // sync a version sent while it is being saved
+    master.setSeed( 17 );
+    const co::uint128_t version = master.commit();
+    TEST( slave.sync( version ) == version );
+    TEST( slave.getSeed() == 17 );
+
+    // map a second slave from the segments saved by the commit
+    Object slave2;
+    TEST( server->mapObject( &slave2, master.getID(), version ));
+    TEST( slave2.getSeed() == 17 );
+
+    server->unmapObject( &slave2 );
+    server->unmapObject( &slave );
+    client->deregisterObject( &master );
+
+    TEST( client->disconnect( serverProxy ));
+    TEST( client->close( ));
+    TEST( server->close( ));
+
+    serverProxy = 0;
+    client      = 0;
+    server      = 0;
+
+    co::exit();
+    return EXIT_SUCCESS;
+}
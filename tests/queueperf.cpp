@@ -0,0 +1,92 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Tests QueueMaster/QueueSlave item throughput
+// Usage: ./queueperf
+
+#include <test.h>
+
+#include <co/init.h>
+#include <co/node.h>
+#include <co/objectICommand.h>
+#include <co/queueItem.h>
+#include <co/queueMaster.h>
+#include <co/queueSlave.h>
+#include <lunchbox/clock.h>
+
+#include <iostream>
+#include <vector>
+
+#define N_ITEMS 20000
+
+static void _testThroughput( co::LocalNodePtr node, const size_t itemSize,
+                             const uint32_t prefetchMark,
+                             const uint32_t prefetchAmount )
+{
+    co::QueueMaster* qm = new co::QueueMaster;
+    co::QueueSlave* qs = new co::QueueSlave( prefetchMark, prefetchAmount );
+
+    TEST( node->registerObject( qm ));
+    TEST( node->mapObject( qs, qm->getID(), co::VERSION_FIRST ));
+
+    std::vector< uint8_t > data( itemSize, 42 );
+    for( uint32_t i = 0; i < N_ITEMS; ++i )
+    {
+        if( itemSize > 0 )
+            qm->push() << i << co::Array< const void >( &data.front(),
+                                                        itemSize );
+        else
+            qm->push() << i;
+    }
+
+    lunchbox::Clock clock;
+    for( uint32_t i = 0; i < N_ITEMS; ++i )
+    {
+        co::ObjectICommand command = qs->pop();
+        TEST( command.isValid( ));
+        TESTINFO( command.get< uint32_t >() == i, i );
+    }
+    const float time = clock.getTimef();
+    TEST( !qs->pop().isValid( ));
+
+    std::cout << itemSize << " byte items, prefetch " << prefetchMark << "/"
+              << prefetchAmount << ": " << N_ITEMS / time * 1000.f
+              << " items/s" << std::endl;
+
+    node->unmapObject( qs );
+    node->deregisterObject( qm );
+    delete qs;
+    delete qm;
+}
+
+int main( int argc, char **argv )
+{
+    TEST( co::init( argc, argv ));
+
+    co::LocalNodePtr node = new co::LocalNode;
+    TEST( node->initLocal( argc, argv ));
+
+    for( size_t itemSize = 0; itemSize <= 4096;
+         itemSize = itemSize ? itemSize << 2 : 16 )
+    {
+        _testThroughput( node, itemSize, 1, 1 );
+        _testThroughput( node, itemSize, 64, 256 );
+    }
+
+    node->close();
+    TEST( co::exit( ));
+    return EXIT_SUCCESS;
+}
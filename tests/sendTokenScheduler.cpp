@@ -0,0 +1,115 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <test.h>
+
+#include <co/global.h>
+#include <co/init.h>
+#include <co/node.h>
+#include <co/sendTokenScheduler.h>
+
+// Tests the token limit, weighted sharing, pre-granting and reclaiming of the
+// send token scheduler
+
+#define N_ROUNDS 300
+
+int main( int argc, char **argv )
+{
+    TEST( co::init( argc, argv ));
+    {
+        co::NodePtr heavy = new co::Node;
+        co::NodePtr light = new co::Node;
+        co::SendTokenScheduler scheduler;
+        co::SendTokenScheduler::Grants grants;
+        scheduler.setMaxTokens( 2 );
+
+        // token limit
+        scheduler.request( heavy, 1, 1, 0, grants );
+        scheduler.request( heavy, 2, 1, 0, grants );
+        scheduler.request( light, 3, 1, 0, grants );
+        TESTINFO( grants.size() == 2, grants.size( ));
+        TEST( scheduler.getAvailable() == 0 );
+        TEST( scheduler.getNumWaiting() == 1 );
+
+        scheduler.release( heavy, false, 0, grants );
+        TESTINFO( grants.size() == 3, grants.size( ));
+        TEST( grants.back().node == light );
+        TEST( grants.back().requestID == 3 );
+
+        scheduler.release( heavy, false, 0, grants );
+        scheduler.release( light, false, 0, grants );
+        TEST( scheduler.getAvailable() == 2 );
+        TEST( scheduler.getNumWaiting() == 0 );
+
+        // weighted sharing: both nodes always have a request waiting
+        scheduler.setMaxTokens( 1 );
+        grants.clear();
+        scheduler.request( heavy, 0, 3, 0, grants );
+        scheduler.request( light, 0, 1, 0, grants );
+
+        size_t nHeavy = 0;
+        for( size_t i = 0; i < N_ROUNDS; ++i )
+        {
+            TESTINFO( grants.size() == 1, grants.size( ));
+            co::NodePtr node = grants.front().node;
+            if( node == heavy )
+                ++nHeavy;
+
+            grants.clear();
+            scheduler.request( node, 0, node == heavy ? 3 : 1, 0, grants );
+            scheduler.release( node, false, 0, grants );
+        }
+        TESTINFO( nHeavy >= N_ROUNDS * 7 / 10 && nHeavy <= N_ROUNDS * 8 / 10,
+                  nHeavy );
+
+        const co::NodePtr holder = grants.front().node;
+        grants.clear();
+        scheduler.release( holder, false, 0, grants );
+        TESTINFO( grants.size() == 1, grants.size( )); // last waiting request
+        scheduler.release( grants.front().node, false, 0, grants );
+        grants.clear();
+        TEST( scheduler.getNumWaiting() == 0 );
+
+        // pre-granting to a streaming sender
+        TEST( scheduler.getAvailable() == 1 );
+        scheduler.request( light, 4, 1, 0, grants );
+        scheduler.release( light, true, 0, grants );
+        TESTINFO( grants.size() == 2, grants.size( ));
+        TEST( grants.back().requestID == LB_UNDEFINED_UINT32 );
+        TEST( scheduler.getAvailable() == 0 );
+
+        // unused pre-granted tokens expire
+        grants.clear();
+        const uint64_t lease = co::Global::getKeepaliveTimeout();
+        scheduler.request( heavy, 5, 1, lease / 2, grants );
+        TEST( grants.empty( ));
+        scheduler.request( heavy, 6, 1, lease + 1, grants );
+        TESTINFO( grants.size() == 1, grants.size( ));
+        TEST( grants.front().node == heavy );
+        scheduler.release( light, false, lease + 1, grants ); // too late
+        TEST( scheduler.getAvailable() == 0 );
+
+        // a disconnected node returns its tokens
+        grants.clear();
+        scheduler.request( light, 7, 1, lease + 1, grants );
+        scheduler.remove( heavy->getNodeID(), grants );
+        TESTINFO( grants.size() == 1, grants.size( ));
+        TEST( grants.front().node == light );
+        TEST( scheduler.getNumWaiting() == 0 );
+    }
+    TEST( co::exit( ));
+    return EXIT_SUCCESS;
+}
@@ -15,7 +15,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
-// Tests network throughput
+// Tests network throughput and latency
 // Usage: see 'netPerf -h'
 
 #define LB_RELEASE_ASSERT
@@ -27,6 +27,8 @@
 #endif
 #include <tclap/CmdLine.h>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 namespace
@@ -296,6 +298,394 @@ private:
     bool _useThreads;
 };
 
+//----------------------------------------------------------------------
+// local mode: writer and reader connections within this process
+//----------------------------------------------------------------------
+typedef std::vector< double > Samples;
+lunchbox::Clock _localClock;
+
+/** @return the time since startup in microseconds. */
+double _getTime() { return _localClock.getTimed() * 1000.; }
+
+/** A writer and a reader connected within this process. */
+struct LocalPair
+{
+    LocalPair() : type( co::CONNECTIONTYPE_NONE ) {}
+
+    bool connect( const std::string& string )
+        {
+            std::string data = string;
+            co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
+            if( !desc->fromString( data ))
+                return false;
+
+            type = desc->type;
+            listener = co::Connection::create( desc );
+            if( !listener )
+                return false;
+
+            switch( type ) // different connections, different semantics...
+            {
+                case co::CONNECTIONTYPE_PIPE:
+                    writer = listener;
+                    if( !writer->connect( ))
+                        return false;
+                    reader = writer->acceptSync();
+                    break;
+
+                case co::CONNECTIONTYPE_RSP:
+                    if( !listener->listen( ))
+                        return false;
+                    listener->acceptNB();
+                    writer = listener;
+                    reader = listener->acceptSync();
+                    break;
+
+                default:
+                    if( !listener->listen( )) // sets the port of desc
+                        return false;
+                    listener->acceptNB();
+                    writer = co::Connection::create( desc );
+                    if( !writer->connect( ))
+                        return false;
+                    reader = listener->acceptSync();
+                    break;
+            }
+            return reader.isValid();
+        }
+
+    void close()
+        {
+            if( writer )
+                writer->close();
+            if( reader )
+                reader->close();
+            if( listener )
+                listener->close();
+            writer = 0;
+            reader = 0;
+            listener = 0;
+        }
+
+    co::ConnectionType type;
+    co::ConnectionPtr listener;
+    co::ConnectionPtr writer;
+    co::ConnectionPtr reader;
+};
+
+class StreamSender : public lunchbox::Thread
+{
+public:
+    StreamSender( co::ConnectionPtr connection, const size_t packetSize,
+                  const size_t nPackets )
+            : _connection( connection ), _nPackets( nPackets )
+        {
+            _buffer.resize( packetSize );
+            for( size_t i = 0; i < packetSize; ++i )
+                _buffer[i] = static_cast< uint8_t >( i );
+        }
+
+    virtual void run()
+        {
+            for( size_t i = 0; i < _nPackets; ++i )
+            {
+                _buffer[SEQUENCE] = uint8_t( i );
+                if( !_connection->send( _buffer.getData(), _buffer.getSize( )))
+                    return;
+            }
+        }
+
+private:
+    co::ConnectionPtr _connection;
+    lunchbox::Buffer< uint8_t > _buffer;
+    const size_t _nPackets;
+};
+
+class StreamReceiver : public lunchbox::Thread
+{
+public:
+    StreamReceiver( co::ConnectionPtr connection, const size_t packetSize,
+                    const size_t nPackets )
+            : _connection( connection ), _packetSize( packetSize )
+            , _nPackets( nPackets ), _nReceived( 0 ), _end( 0. ) {}
+
+    virtual void run()
+        {
+            for( ; _nReceived < _nPackets; ++_nReceived )
+            {
+                _buffer.setSize( 0 );
+                _connection->recvNB( &_buffer, _packetSize );
+
+                co::BufferPtr buffer;
+                if( !_connection->recvSync( buffer ))
+                    break;
+            }
+            _end = _getTime();
+        }
+
+    size_t getNumReceived() const { return _nReceived; }
+    double getEndTime() const { return _end; }
+
+private:
+    co::ConnectionPtr _connection;
+    co::Buffer _buffer;
+    const size_t _packetSize;
+    const size_t _nPackets;
+    size_t _nReceived;
+    double _end;
+};
+
+/**
+ * Reflects received packets to the sender. Multicast connections can't reply,
+ * instead the one-way latency is recorded using the send time in the packet.
+ */
+class Echo : public lunchbox::Thread
+{
+public:
+    Echo( co::ConnectionPtr connection, const size_t packetSize,
+          const size_t nPackets, const bool oneWay )
+            : _connection( connection ), _packetSize( packetSize )
+            , _nPackets( nPackets ), _oneWay( oneWay ), _nReceived( 0 ) {}
+
+    virtual void run()
+        {
+            for( size_t i = 0; i < _nPackets; ++i )
+            {
+                _buffer.setSize( 0 );
+                _connection->recvNB( &_buffer, _packetSize );
+
+                co::BufferPtr buffer;
+                if( !_connection->recvSync( buffer ))
+                    break;
+
+                if( _oneWay )
+                {
+                    double sendTime;
+                    ::memcpy( &sendTime, _buffer.getData(), sizeof( sendTime ));
+                    samples.push_back( _getTime() - sendTime );
+                    ++_nReceived;
+                }
+                else if( !_connection->send( _buffer.getData(),
+                                             _buffer.getSize( )))
+                {
+                    break;
+                }
+            }
+            _nReceived = _nPackets; // don't block the sender on errors
+        }
+
+    /** Wait until the given number of packets has been received. */
+    void waitReceived( const size_t n ) { _nReceived.waitGE( n ); }
+
+    Samples samples; //!< one-way latencies
+
+private:
+    co::ConnectionPtr _connection;
+    co::Buffer _buffer;
+    const size_t _packetSize;
+    const size_t _nPackets;
+    const bool _oneWay;
+    lunchbox::Monitor< size_t > _nReceived;
+};
+
+double _getPercentile( const Samples& sorted, const double p )
+{
+    return sorted[ size_t( p * double( sorted.size() - 1 ) + .5 ) ];
+}
+
+void _printResult( const std::string& mode, const co::ConnectionType type,
+                   const size_t nStreams, const size_t packetSize,
+                   const size_t nPackets, const double time, Samples& samples )
+{
+    const double seconds = time / 1000000.;
+    const double pps = seconds > 0. ? nPackets / seconds : 0.;
+    const lunchbox::ScopedMutex<> mutex( _mutexPrint );
+
+    std::cout << mode << ',' << type << ',' << nStreams << ',' << packetSize
+              << ',' << nPackets << ',' << time / 1000. << ','
+              << pps * packetSize / 1024. / 1024. << ',' << pps;
+    if( samples.empty( ))
+    {
+        std::cout << ",,,,," << std::endl;
+        return;
+    }
+
+    std::sort( samples.begin(), samples.end( ));
+    std::cout << ',' << samples.front() << ',' << _getPercentile( samples, .5 )
+              << ',' << _getPercentile( samples, .99 ) << ','
+              << _getPercentile( samples, .999 ) << ',' << samples.back()
+              << std::endl;
+}
+
+bool _runStreams( const std::string& description, const size_t packetSize,
+                  const size_t nPackets, const size_t nStreams )
+{
+    std::vector< LocalPair > pairs( nStreams );
+    std::vector< StreamSender* > senders;
+    std::vector< StreamReceiver* > receivers;
+    bool ok = true;
+
+    for( size_t i = 0; i < nStreams && ok; ++i )
+    {
+        ok = pairs[i].connect( description );
+        if( !ok )
+            break;
+        senders.push_back( new StreamSender( pairs[i].writer, packetSize,
+                                             nPackets ));
+        receivers.push_back( new StreamReceiver( pairs[i].reader, packetSize,
+                                                 nPackets ));
+    }
+
+    const double start = _getTime();
+    double end = start;
+    size_t nReceived = 0;
+    if( ok )
+    {
+        for( size_t i = 0; i < nStreams; ++i )
+        {
+            receivers[i]->start();
+            senders[i]->start();
+        }
+        for( size_t i = 0; i < nStreams; ++i )
+        {
+            senders[i]->join();
+            receivers[i]->join();
+            end = LB_MAX( end, receivers[i]->getEndTime( ));
+            nReceived += receivers[i]->getNumReceived();
+        }
+        ok = ( nReceived == nStreams * nPackets );
+    }
+
+    const co::ConnectionType type = pairs.front().type;
+    for( size_t i = 0; i < pairs.size(); ++i )
+        pairs[i].close();
+    for( size_t i = 0; i < senders.size(); ++i )
+    {
+        delete senders[i];
+        delete receivers[i];
+    }
+
+    if( !ok )
+    {
+        LBERROR << "Stream benchmark using " << description << " failed"
+                << std::endl;
+        return false;
+    }
+
+    Samples samples;
+    _printResult( "stream", type, nStreams, packetSize, nReceived, end - start,
+                  samples );
+    return true;
+}
+
+bool _runLatency( const std::string& description, const size_t packetSize,
+                  const size_t nPackets )
+{
+    LocalPair pair;
+    if( !pair.connect( description ))
+    {
+        pair.close();
+        LBERROR << "Can't connect " << description << std::endl;
+        return false;
+    }
+
+    const bool oneWay = pair.type >= co::CONNECTIONTYPE_MULTICAST;
+    Echo echo( pair.reader, packetSize, nPackets, oneWay );
+    echo.start();
+
+    lunchbox::Buffer< uint8_t > ping;
+    ping.resize( packetSize );
+    for( size_t i = 0; i < packetSize; ++i )
+        ping[i] = static_cast< uint8_t >( i );
+
+    co::Buffer pong;
+    Samples samples;
+    bool ok = true;
+    const double start = _getTime();
+
+    for( size_t i = 0; i < nPackets && ok; ++i )
+    {
+        if( !oneWay )
+        {
+            pong.setSize( 0 );
+            pair.writer->recvNB( &pong, packetSize );
+        }
+
+        const double sendTime = _getTime();
+        ::memcpy( ping.getData(), &sendTime, sizeof( sendTime ));
+        ok = pair.writer->send( ping.getData(), packetSize );
+        if( !ok )
+            break;
+
+        if( oneWay )
+        {
+            echo.waitReceived( i + 1 );
+            continue;
+        }
+
+        co::BufferPtr buffer;
+        ok = pair.writer->recvSync( buffer );
+        samples.push_back( _getTime() - sendTime );
+    }
+
+    const double time = _getTime() - start;
+    pair.close();
+    echo.join();
+
+    if( oneWay )
+        samples.swap( echo.samples );
+    if( !ok || samples.size() != nPackets )
+    {
+        LBERROR << "Latency benchmark using " << description << " failed"
+                << std::endl;
+        return false;
+    }
+
+    _printResult( oneWay ? "oneway" : "latency", pair.type, 1, packetSize,
+                  nPackets, time, samples );
+    return true;
+}
+
+/** Run the selected benchmark for each packet size, printing CSV results. */
+bool _runLocal( const std::string& description, const size_t maxPacketSize,
+                const size_t nPackets, size_t nStreams, const bool latency,
+                const bool sweep )
+{
+    std::string data = description;
+    co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
+    if( !desc->fromString( data ))
+    {
+        LBERROR << "Can't parse connection description " << description
+                << std::endl;
+        return false;
+    }
+    if( desc->type >= co::CONNECTIONTYPE_MULTICAST && nStreams > 1 )
+    {
+        LBWARN << "Multicast supports only one stream per group" << std::endl;
+        nStreams = 1;
+    }
+
+    std::vector< size_t > sizes;
+    if( sweep )
+        for( size_t size = 64; size < maxPacketSize; size <<= 1 )
+            sizes.push_back( size );
+    sizes.push_back( LB_MAX( maxPacketSize, sizeof( double )));
+
+    std::cout << "mode,type,streams,packetSize,packets,time_ms,MBPerSec,"
+              << "packetsPerSec,latencyMin_us,latency50_us,latency99_us,"
+              << "latency999_us,latencyMax_us" << std::endl;
+
+    bool ok = true;
+    for( size_t i = 0; i < sizes.size(); ++i )
+    {
+        if( latency )
+            ok = _runLatency( description, sizes[i], nPackets ) && ok;
+        else
+            ok = _runStreams( description, sizes[i], nPackets, nStreams ) &&ok;
+    }
+    return ok;
+}
+
 }
 
 int main( int argc, char **argv )
@@ -311,6 +701,10 @@ int main( int argc, char **argv )
     size_t packetSize = 1048576;
     size_t nPackets   = 0xffffffffu;
     uint32_t waitTime = 0;
+    std::string local;
+    size_t nStreams   = 1;
+    bool latency      = false;
+    bool sweep        = false;
 
     try // command line parsing
     {
@@ -322,6 +716,20 @@ int main( int argc, char **argv )
         TCLAP::ValueArg< std::string > serverArg( "s", "server",
                                                   "run as server", true, "",
                                                   "IP[:port][:protocol]" );
+        TCLAP::ValueArg< std::string > localArg( "l", "local",
+                          "run writer and reader in this process, CSV output",
+                                                 true, "",
+                                                 "IP[:port][:protocol]" );
+        TCLAP::SwitchArg latencyArg( "L", "latency",
+                                  "measure round-trip latency (local only)",
+                                     command, false );
+        TCLAP::ValueArg<size_t> streamsArg( "m", "streams",
+                   "number of concurrent connections and threads (local only)",
+                                            false, nStreams, "unsigned",
+                                            command );
+        TCLAP::SwitchArg sweepArg( "S", "sweep",
+                 "sweep packet sizes from 64 bytes to packetSize (local only)",
+                                   command, false );
         TCLAP::SwitchArg threadedArg( "t", "threaded", 
                           "Run each receive in a separate thread (server only)",
                                       command, false );
@@ -339,10 +747,19 @@ int main( int argc, char **argv )
                                 "wait time (ms) between receives (server only)",
                                             false, 0, "unsigned", command );
 
-        command.xorAdd( clientArg, serverArg );
+        std::vector< TCLAP::Arg* > modes;
+        modes.push_back( &clientArg );
+        modes.push_back( &serverArg );
+        modes.push_back( &localArg );
+        command.xorAdd( modes );
         command.parse( argc, argv );
 
-        if( clientArg.isSet( ))
+        if( localArg.isSet( ))
+        {
+            local = localArg.getValue();
+            nPackets = 1000;
+        }
+        else if( clientArg.isSet( ))
             description->fromString( clientArg.getValue( ));
         else if( serverArg.isSet( ))
         {
@@ -351,6 +768,9 @@ int main( int argc, char **argv )
         }
 
         useThreads = threadedArg.isSet();
+        latency = latencyArg.isSet();
+        sweep = sweepArg.isSet();
+        nStreams = LB_MAX( streamsArg.getValue(), size_t( 1 ));
 
         if( sizeArg.isSet( ))
             packetSize = sizeArg.getValue();
@@ -371,6 +791,14 @@ int main( int argc, char **argv )
     }
 
     // run
+    if( !local.empty( ))
+    {
+        const bool ok = _runLocal( local, packetSize, nPackets, nStreams,
+                                   latency, sweep );
+        LBCHECK( co::exit( ));
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     co::ConnectionPtr connection = co::Connection::create( description );
     if( !connection )
     {
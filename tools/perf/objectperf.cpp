@@ -0,0 +1,499 @@
+/* Copyright (c) 2012, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Benchmarks commit->sync throughput and latency of co::Objects. The master
+// and all slave nodes run in this process and communicate over loopback.
+// Usage: see 'coObjectperf -h'
+
+#include <co/co.h>
+#include <co/plugins/compressorTypes.h>
+#include <lunchbox/clock.h>
+#include <tclap/CmdLine.h>
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+lunchbox::Clock clock_;
+
+/** @return the time since startup in microseconds. */
+double getTime() { return clock_.getTimed() * 1000.; }
+
+struct Config
+{
+    co::Object::ChangeType changeType;
+    uint32_t compressor; // EQ_COMPRESSOR_INVALID: Object default
+    uint64_t size;       // bytes
+    uint32_t nSlaves;
+    uint32_t obsolete;
+};
+
+struct Result
+{
+    Result() : bytes( 0 ), time( 0. ), commitTime( 0. ) {}
+
+    uint64_t bytes;                // payload per commit
+    double time;                   // first commit to last sync, us
+    double commitTime;             // average commit() duration, us
+    std::vector< double > latency; // commit to sync per version and slave, us
+};
+
+class Object : public co::Object
+{
+public:
+    Object( const Config& config, const uint64_t deltaPercent )
+        : config_( config )
+        , data_( std::max( config.size / sizeof( uint64_t ), uint64_t( 1 )))
+        , nDelta_( std::max( data_.size() * deltaPercent / 100,
+                             size_t( 1 )))
+        , offset_( 0 )
+    {
+        for( size_t i = 0; i < data_.size(); ++i )
+            data_[ i ] = i;
+    }
+
+    /** Change the data to be sent by the next commit. */
+    void update( const uint64_t value )
+    {
+        offset_ += nDelta_;
+        if( offset_ + nDelta_ > data_.size( ))
+            offset_ = 0;
+        std::fill( data_.begin() + offset_, data_.begin() + offset_ + nDelta_,
+                   value );
+    }
+
+    /** @return the number of bytes sent by each commit. */
+    uint64_t getCommitSize() const
+    {
+        const size_t nElems = config_.changeType == DELTA ? nDelta_ :
+                                                            data_.size();
+        return nElems * sizeof( uint64_t );
+    }
+
+protected:
+    virtual ChangeType getChangeType() const { return config_.changeType; }
+
+    virtual uint32_t chooseCompressor() const
+    {
+        if( config_.compressor == EQ_COMPRESSOR_INVALID )
+            return co::Object::chooseCompressor();
+        return config_.compressor;
+    }
+
+    virtual void getInstanceData( co::DataOStream& os ) { os << data_; }
+    virtual void applyInstanceData( co::DataIStream& is ) { is >> data_; }
+
+    virtual void pack( co::DataOStream& os )
+    {
+        if( config_.changeType != DELTA )
+        {
+            getInstanceData( os );
+            return;
+        }
+        os << uint64_t( offset_ ) << uint64_t( nDelta_ )
+           << co::Array< const uint64_t >( &data_[ offset_ ], nDelta_ );
+    }
+
+    virtual void unpack( co::DataIStream& is )
+    {
+        if( config_.changeType != DELTA )
+        {
+            applyInstanceData( is );
+            return;
+        }
+        uint64_t offset = 0;
+        uint64_t nElems = 0;
+        is >> offset >> nElems;
+        LBASSERT( offset + nElems <= data_.size( ));
+        is >> co::Array< uint64_t >( &data_[ offset ], nElems );
+    }
+
+private:
+    const Config config_;
+    std::vector< uint64_t > data_;
+    const size_t nDelta_;
+    size_t offset_;
+};
+
+/** Syncs all versions of a slave object and records their arrival time. */
+class SlaveThread : public lunchbox::Thread
+{
+public:
+    SlaveThread( Object& object, const uint32_t nCommits )
+        : object_( object ), syncTimes_( nCommits, 0. ) {}
+
+    virtual void run()
+    {
+        co::uint128_t version = object_.getVersion();
+        for( size_t i = 0; i < syncTimes_.size(); ++i )
+        {
+            object_.sync( ++version );
+            syncTimes_[ i ] = getTime();
+        }
+    }
+
+    const std::vector< double >& getSyncTimes() const { return syncTimes_; }
+
+private:
+    Object& object_;
+    std::vector< double > syncTimes_;
+};
+
+co::ConnectionDescriptionPtr newDescription()
+{
+    co::ConnectionDescriptionPtr desc = new co::ConnectionDescription;
+    desc->type = co::CONNECTIONTYPE_TCPIP;
+    desc->port = 0; // any free port, updated by listen()
+    desc->setHostname( "127.0.0.1" );
+    return desc;
+}
+
+bool runBenchmark( const Config& config, const uint32_t nCommits,
+                   const uint64_t deltaPercent, Result& result )
+{
+    co::LocalNodePtr master = new co::LocalNode;
+    co::ConnectionDescriptionPtr masterDesc = newDescription();
+    master->addConnectionDescription( masterDesc );
+    if( !master->listen( ))
+    {
+        LBERROR << "Can't listen on " << masterDesc << std::endl;
+        return false;
+    }
+
+    Object object( config, deltaPercent );
+    LBCHECK( master->registerObject( &object ));
+    object.setAutoObsolete( config.obsolete );
+
+    std::vector< co::LocalNodePtr > slaves;
+    std::vector< Object* > slaveObjects;
+    std::vector< SlaveThread* > threads;
+    bool ok = true;
+
+    for( uint32_t i = 0; i < config.nSlaves && ok; ++i )
+    {
+        co::LocalNodePtr slave = new co::LocalNode;
+        slave->addConnectionDescription( newDescription( ));
+        slaves.push_back( slave );
+
+        co::NodePtr proxy = new co::Node;
+        proxy->addConnectionDescription( masterDesc );
+        if( !slave->listen() || !slave->connect( proxy ))
+        {
+            LBERROR << "Can't connect slave " << i << " to master" << std::endl;
+            ok = false;
+            break;
+        }
+
+        Object* slaveObject = new Object( config, deltaPercent );
+        slaveObjects.push_back( slaveObject );
+        if( !slave->mapObject( slaveObject, object.getID( )))
+        {
+            LBERROR << "Can't map slave object " << i << std::endl;
+            ok = false;
+        }
+    }
+
+    if( ok )
+    {
+        BOOST_FOREACH( Object* slaveObject, slaveObjects )
+            threads.push_back( new SlaveThread( *slaveObject, nCommits ));
+        BOOST_FOREACH( SlaveThread* thread, threads )
+            LBCHECK( thread->start( ));
+
+        std::vector< double > commitTimes( nCommits );
+        const double start = getTime();
+        for( uint32_t i = 0; i < nCommits; ++i )
+        {
+            object.update( i );
+            commitTimes[ i ] = getTime();
+            object.commit();
+        }
+        result.commitTime = ( getTime() - start ) / nCommits;
+
+        double end = start;
+        BOOST_FOREACH( SlaveThread* thread, threads )
+        {
+            thread->join();
+            const std::vector< double >& syncTimes = thread->getSyncTimes();
+            for( uint32_t i = 0; i < nCommits; ++i )
+                result.latency.push_back( syncTimes[ i ] - commitTimes[ i ]);
+            end = std::max( end, syncTimes.back( ));
+        }
+        result.bytes = object.getCommitSize();
+        result.time = end - start;
+        std::sort( result.latency.begin(), result.latency.end( ));
+    }
+
+    for( size_t i = 0; i < slaveObjects.size(); ++i )
+    {
+        if( slaveObjects[ i ]->isAttached( ))
+            slaves[ i ]->unmapObject( slaveObjects[ i ] );
+        delete slaveObjects[ i ];
+    }
+    BOOST_FOREACH( SlaveThread* thread, threads )
+        delete thread;
+    master->deregisterObject( &object );
+
+    BOOST_FOREACH( co::LocalNodePtr slave, slaves )
+        slave->close();
+    master->close();
+    return ok;
+}
+
+double getPercentile( const std::vector< double >& sorted, const float p )
+{
+    if( sorted.empty( ))
+        return 0.;
+    const size_t i = size_t( p * float( sorted.size() - 1 ) + .5f );
+    return sorted[ i ];
+}
+
+std::string getCompressorName( const uint32_t compressor )
+{
+    if( compressor == EQ_COMPRESSOR_INVALID )
+        return "auto";
+    if( compressor == EQ_COMPRESSOR_NONE )
+        return "none";
+    std::ostringstream os;
+    os << "0x" << std::hex << compressor;
+    return os.str();
+}
+
+void printHeader( const bool json )
+{
+    if( json )
+        std::cout << "[" << std::endl;
+    else
+        std::cout << "changeType,compressor,size,slaves,autoObsolete,commits,"
+                  << "commitBytes,time_ms,commitsPerSec,MBPerSec,commit_us,"
+                  << "latencyMin_us,latency50_us,latency90_us,latency99_us,"
+                  << "latencyMax_us" << std::endl;
+}
+
+void printResult( const Config& config, const uint32_t nCommits,
+                  const Result& result, const bool json, const bool first )
+{
+    const double seconds = result.time / 1000000.;
+    const double commitsSec = seconds > 0. ? nCommits / seconds : 0.;
+    const double mBytesSec = commitsSec * result.bytes / 1024. / 1024.;
+    const std::vector< double >& latency = result.latency;
+
+    std::ostringstream changeType;
+    changeType << config.changeType;
+
+    std::cout << std::fixed << std::setprecision( 3 );
+    if( json )
+    {
+        std::cout << ( first ? "  " : ", " ) << "{ \"changeType\": \""
+                  << changeType.str() << "\", \"compressor\": \""
+                  << getCompressorName( config.compressor )
+                  << "\", \"size\": " << config.size
+                  << ", \"slaves\": " << config.nSlaves
+                  << ", \"autoObsolete\": " << config.obsolete
+                  << ", \"commits\": " << nCommits
+                  << ", \"commitBytes\": " << result.bytes
+                  << ", \"time_ms\": " << result.time / 1000.
+                  << ", \"commitsPerSec\": " << commitsSec
+                  << ", \"MBPerSec\": " << mBytesSec
+                  << ", \"commit_us\": " << result.commitTime
+                  << ", \"latency_us\": { \"min\": "
+                  << getPercentile( latency, 0.f )
+                  << ", \"p50\": " << getPercentile( latency, .5f )
+                  << ", \"p90\": " << getPercentile( latency, .9f )
+                  << ", \"p99\": " << getPercentile( latency, .99f )
+                  << ", \"max\": " << getPercentile( latency, 1.f )
+                  << " } }" << std::endl;
+        return;
+    }
+
+    std::cout << changeType.str() << ','
+              << getCompressorName( config.compressor ) << ','
+              << config.size << ',' << config.nSlaves << ','
+              << config.obsolete << ',' << nCommits << ',' << result.bytes
+              << ',' << result.time / 1000. << ',' << commitsSec << ','
+              << mBytesSec << ',' << result.commitTime << ','
+              << getPercentile( latency, 0.f ) << ','
+              << getPercentile( latency, .5f ) << ','
+              << getPercentile( latency, .9f ) << ','
+              << getPercentile( latency, .99f ) << ','
+              << getPercentile( latency, 1.f ) << std::endl;
+}
+
+std::vector< std::string > split( const std::string& list )
+{
+    std::vector< std::string > items;
+    std::istringstream is( list );
+    std::string item;
+    while( std::getline( is, item, ',' ))
+        if( !item.empty( ))
+            items.push_back( item );
+    return items;
+}
+
+template< class T > std::vector< T > parseNumbers( const std::string& list )
+{
+    std::vector< T > values;
+    BOOST_FOREACH( const std::string& item, split( list ))
+    {
+        std::istringstream is( item );
+        T value;
+        if( !( is >> value ))
+            throw TCLAP::ArgException( "not a number", item );
+        values.push_back( value );
+    }
+    return values;
+}
+
+std::vector< co::Object::ChangeType > parseTypes( const std::string& list )
+{
+    std::vector< co::Object::ChangeType > types;
+    BOOST_FOREACH( std::string item, split( list ))
+    {
+        std::transform( item.begin(), item.end(), item.begin(), ::toupper );
+        if( item == "INSTANCE" )
+            types.push_back( co::Object::INSTANCE );
+        else if( item == "DELTA" )
+            types.push_back( co::Object::DELTA );
+        else if( item == "UNBUFFERED" )
+            types.push_back( co::Object::UNBUFFERED );
+        else
+            throw TCLAP::ArgException( "unknown change type", item );
+    }
+    return types;
+}
+
+std::vector< uint32_t > parseCompressors( const std::string& list )
+{
+    std::vector< uint32_t > compressors;
+    BOOST_FOREACH( const std::string& item, split( list ))
+    {
+        if( item == "auto" )
+            compressors.push_back( EQ_COMPRESSOR_INVALID );
+        else if( item == "none" )
+            compressors.push_back( EQ_COMPRESSOR_NONE );
+        else
+        {
+            char* end = 0;
+            const unsigned long name = ::strtoul( item.c_str(), &end, 0 );
+            if( *end != '\0' || name <= EQ_COMPRESSOR_NONE )
+                throw TCLAP::ArgException( "unknown compressor", item );
+            compressors.push_back( uint32_t( name ));
+        }
+    }
+    return compressors;
+}
+}
+
+int main( int argc, char **argv )
+{
+    if( !co::init( argc, argv ))
+        return EXIT_FAILURE;
+
+    std::vector< uint64_t > sizes;
+    std::vector< co::Object::ChangeType > types;
+    std::vector< uint32_t > compressors;
+    std::vector< uint32_t > slaves;
+    std::vector< uint32_t > obsoletes;
+    uint32_t nCommits = 100;
+    uint64_t deltaPercent = 10;
+    bool json = false;
+
+    try // command line parsing
+    {
+        TCLAP::CmdLine command(
+            "objectperf - Collage object commit/sync benchmark tool", ' ',
+            co::Version::getString( ));
+        TCLAP::ValueArg< std::string > sizesArg( "s", "sizes",
+                                 "comma-separated object sizes in bytes", false,
+                                 "1024,65536,1048576", "list", command );
+        TCLAP::ValueArg< std::string > typesArg( "t", "types",
+                           "comma-separated change types (INSTANCE, DELTA, "
+                           "UNBUFFERED)", false, "INSTANCE,DELTA,UNBUFFERED",
+                                                 "list", command );
+        TCLAP::ValueArg< std::string > compressorsArg( "c", "compressors",
+                                "comma-separated compressors (auto, none or a "
+                                "numeric compressor name, e.g. 0x3)", false,
+                                                       "none", "list",
+                                                       command );
+        TCLAP::ValueArg< std::string > slavesArg( "n", "slaves",
+                                    "comma-separated numbers of slave nodes",
+                                                  false, "1", "list", command );
+        TCLAP::ValueArg< std::string > obsoleteArg( "a", "autoObsolete",
+                              "comma-separated auto obsolete depths", false,
+                                                    "0", "list", command );
+        TCLAP::ValueArg< uint32_t > commitsArg( "i", "commits",
+                                                "number of commits per run",
+                                                false, nCommits, "unsigned",
+                                                command );
+        TCLAP::ValueArg< uint64_t > deltaArg( "d", "delta",
+                                  "percentage of the object changed per commit",
+                                              false, deltaPercent, "unsigned",
+                                              command );
+        TCLAP::SwitchArg jsonArg( "j", "json", "JSON instead of CSV output",
+                                  command, false );
+        command.parse( argc, argv );
+
+        sizes = parseNumbers< uint64_t >( sizesArg.getValue( ));
+        types = parseTypes( typesArg.getValue( ));
+        compressors = parseCompressors( compressorsArg.getValue( ));
+        slaves = parseNumbers< uint32_t >( slavesArg.getValue( ));
+        obsoletes = parseNumbers< uint32_t >( obsoleteArg.getValue( ));
+        nCommits = std::max( commitsArg.getValue(), 1u );
+        deltaPercent = std::min( deltaArg.getValue(), uint64_t( 100 ));
+        json = jsonArg.isSet();
+    }
+    catch( TCLAP::ArgException& exception )
+    {
+        LBERROR << "Command line parse error: " << exception.error()
+                << " for argument " << exception.argId() << std::endl;
+
+        co::exit();
+        return EXIT_FAILURE;
+    }
+
+    printHeader( json );
+    bool first = true;
+    bool ok = true;
+
+    BOOST_FOREACH( const co::Object::ChangeType type, types )
+    BOOST_FOREACH( const uint32_t compressor, compressors )
+    BOOST_FOREACH( const uint64_t size, sizes )
+    BOOST_FOREACH( const uint32_t nSlaves, slaves )
+    BOOST_FOREACH( const uint32_t obsolete, obsoletes )
+    {
+        const Config config = { type, compressor, size, nSlaves, obsolete };
+        Result result;
+        if( !runBenchmark( config, nCommits, deltaPercent, result ))
+        {
+            ok = false;
+            continue;
+        }
+        printResult( config, nCommits, result, json, first );
+        first = false;
+    }
+
+    if( json )
+        std::cout << "]" << std::endl;
+
+    LBCHECK( co::exit( ));
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}